@@ -0,0 +1,186 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(MCPP_BENCH_PERF_COUNTERS) && defined(__linux__)
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MCPP_BENCH_HAS_PERF_COUNTERS 1
+#endif
+
+// Minimal benchmark harness. Each benchmark is a callable that performs a known number of operations; it is run a few
+// times and the fastest run is reported, which filters out most scheduling and frequency-scaling noise.
+namespace bench {
+
+template <class T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+#endif
+}
+
+// Hardware events reported per operation when the benchmarks are built with mcpp-unique-any_WITH_PERF_COUNTERS=ON on
+// Linux. Events the CPU or the kernel does not provide are reported as "-".
+enum counter : std::size_t {
+    cycles,
+    instructions,
+    branch_misses,
+    l1d_misses,
+    llc_misses,
+    indirect_misses,
+    n_counters,
+};
+
+constexpr inline const char *counter_names[n_counters] = {"cycles", "instr", "br-miss", "L1d-miss", "LLC-miss",
+                                                           "ind-miss"};
+
+#if defined(MCPP_BENCH_HAS_PERF_COUNTERS)
+// Counts the events of the calling thread, and of threads it starts, in user space. Every event is opened on its own
+// rather than as a group, so that the ones the PMU cannot schedule together are multiplexed and scaled instead of
+// failing as a whole.
+//
+// There is no generic event for mispredicted indirect branches. Set MCPP_BENCH_INDIRECT_MISS_EVENT to the raw event
+// code of the CPU (for example 0x80c5, BR_MISP_RETIRED.INDIRECT, on recent Intel cores) to count them.
+class perf_counters {
+  public:
+    perf_counters() {
+        open(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open(l1d_misses, PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        open(llc_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        if (const auto *raw = std::getenv("MCPP_BENCH_INDIRECT_MISS_EVENT")) {
+            open(indirect_misses, PERF_TYPE_RAW, std::strtoull(raw, nullptr, 0));
+        }
+    }
+    perf_counters(const perf_counters &other) = delete;
+    auto operator=(const perf_counters &rhs) -> perf_counters & = delete;
+    ~perf_counters() {
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    void start() noexcept {
+        for (auto fd : fds_) {
+            if (fd >= 0) {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    // Returns the counts since start(), or -1 for events that are not available.
+    auto stop() noexcept -> std::array<double, n_counters> {
+        auto ret = std::array<double, n_counters>();
+        for (auto i = std::size_t{0}; i < n_counters; ++i) {
+            ret[i] = -1;
+            if (fds_[i] < 0) {
+                continue;
+            }
+            ::ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            std::uint64_t values[3] = {}; // value, time enabled, time running
+            if (::read(fds_[i], values, sizeof(values)) == static_cast<ssize_t>(sizeof(values)) && values[2] != 0) {
+                auto scale = static_cast<double>(values[1]) / static_cast<double>(values[2]);
+                ret[i] = static_cast<double>(values[0]) * scale;
+            }
+        }
+        return ret;
+    }
+
+  private:
+    void open(counter c, std::uint32_t type, std::uint64_t config) noexcept {
+        auto attr = perf_event_attr();
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds_[c] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    std::array<int, n_counters> fds_ = {-1, -1, -1, -1, -1, -1};
+};
+#else
+// Stand-in when the benchmarks are built without performance counters.
+class perf_counters {
+  public:
+    void start() noexcept {}
+    auto stop() noexcept -> std::array<double, n_counters> {
+        auto ret = std::array<double, n_counters>();
+        ret.fill(-1);
+        return ret;
+    }
+};
+#endif
+
+// Shared by all benchmarks of the program, so that the events are opened only once.
+inline auto counters() -> perf_counters & {
+    static auto instance = perf_counters();
+    return instance;
+}
+
+struct result {
+    const char *name;
+    double ns_per_op;
+    std::array<double, n_counters> per_op; // Counter values per operation, -1 if not measured
+};
+
+template <class F>
+auto run(const char *name, std::size_t n_ops, F &&fn, int n_runs = 5) -> result {
+    using clock = std::chrono::steady_clock;
+    auto &counters = bench::counters();
+    auto best = clock::duration::max();
+    auto best_counts = std::array<double, n_counters>();
+    for (auto i = 0; i < n_runs; ++i) {
+        counters.start();
+        auto start = clock::now();
+        fn();
+        auto elapsed = clock::now() - start;
+        auto counts = counters.stop();
+        if (elapsed < best) {
+            best = elapsed;
+            best_counts = counts;
+        }
+    }
+    auto ret = result{name, static_cast<double>(std::chrono::nanoseconds(best).count()) / static_cast<double>(n_ops),
+                      {}};
+    std::printf("%-48s %10.2f ns/op", ret.name, ret.ns_per_op);
+    for (auto i = std::size_t{0}; i < n_counters; ++i) {
+        ret.per_op[i] = best_counts[i] < 0 ? -1 : best_counts[i] / static_cast<double>(n_ops);
+#if defined(MCPP_BENCH_HAS_PERF_COUNTERS)
+        if (ret.per_op[i] < 0) {
+            std::printf(" %10s %-8s", "-", counter_names[i]);
+        } else {
+            std::printf(" %10.2f %-8s", ret.per_op[i], counter_names[i]);
+        }
+#endif
+    }
+    std::printf("\n");
+    return ret;
+}
+
+} // namespace bench
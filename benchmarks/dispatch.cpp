@@ -0,0 +1,92 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/unique_any.hpp"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_elements = std::size_t{1} << 16;
+
+template <class Any>
+auto make_elements() -> std::vector<Any> {
+    auto rng = std::mt19937_64(42);
+    auto ret = std::vector<Any>();
+    ret.reserve(n_elements);
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        switch (rng() % 4) {
+            case 0:
+                ret.emplace_back(std::uint64_t{i});
+                break;
+            case 1:
+                ret.emplace_back(static_cast<double>(i));
+                break;
+            case 2:
+                ret.emplace_back(std::make_unique<std::uint64_t>(i));
+                break;
+            default:
+                ret.emplace_back(std::string(40, 'x'));
+                break;
+        }
+    }
+    return ret;
+}
+
+template <class Any>
+void run_all(const char *policy) {
+    auto elements = make_elements<Any>();
+    char name[64];
+
+    std::snprintf(name, sizeof(name), "%s/move", policy);
+    bench::run(name, n_elements, [&] {
+        for (auto &element : elements) {
+            auto tmp = std::move(element);
+            element = std::move(tmp);
+        }
+        bench::do_not_optimize(elements.data());
+    });
+
+    std::snprintf(name, sizeof(name), "%s/any_cast", policy);
+    bench::run(name, n_elements, [&] {
+        auto sum = std::uint64_t{0};
+        for (auto &element : elements) {
+            if (auto *p = any_cast<std::uint64_t>(&element)) {
+                sum += *p;
+            } else if (auto *p = any_cast<std::unique_ptr<std::uint64_t>>(&element)) {
+                sum += **p;
+            }
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    std::snprintf(name, sizeof(name), "%s/emplace", policy);
+    bench::run(name, n_elements, [&] {
+        for (auto &element : elements) {
+            element.template emplace<std::uint64_t>(1);
+        }
+        bench::do_not_optimize(elements.data());
+    });
+}
+
+template <class Dispatch>
+using any_with = basic_unique_any<3 * sizeof(void *), alignof(void *), Dispatch>;
+
+} // namespace
+
+auto main() -> int {
+    std::printf("sizeof: vtable=%zu index=%zu manager=%zu inline=%zu\n", sizeof(any_with<vtable_dispatch>),
+                sizeof(any_with<index_dispatch>), sizeof(any_with<manager_dispatch>),
+                sizeof(any_with<inline_dispatch>));
+    run_all<any_with<vtable_dispatch>>("vtable_dispatch");
+    run_all<any_with<index_dispatch>>("index_dispatch");
+    run_all<any_with<manager_dispatch>>("manager_dispatch");
+    run_all<any_with<inline_dispatch>>("inline_dispatch");
+}
@@ -0,0 +1,49 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_increments = std::size_t{1} << 24;
+
+// Every thread increments the counter in its own slot. With 32-byte unique_any, neighbouring slots share a cache line.
+template <class Any>
+void run_slots(const char *name, unsigned n_threads) {
+    auto slots = std::vector<Any>(n_threads);
+    for (auto &slot : slots) {
+        slot = std::uint64_t{0};
+    }
+    bench::run(name, n_increments * n_threads, [&] {
+        auto threads = std::vector<std::thread>();
+        for (auto t = 0U; t < n_threads; ++t) {
+            threads.emplace_back([&, t] {
+                auto &counter = *any_cast<std::uint64_t>(&slots[t]);
+                for (auto i = std::size_t{0}; i < n_increments; ++i) {
+                    counter += 1;
+                    bench::do_not_optimize(counter);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    });
+}
+
+} // namespace
+
+auto main() -> int {
+    auto n_threads = std::max(2U, std::thread::hardware_concurrency());
+    std::printf("threads: %u\n", n_threads);
+    run_slots<unique_any>("unique_any", n_threads);
+    run_slots<cacheline_unique_any>("cacheline_unique_any", n_threads);
+}
@@ -0,0 +1,112 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/unique_any.hpp"
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto payload_size = std::size_t{4} << 20;
+
+struct mapped_payload {
+    std::array<char, payload_size> data;
+};
+
+struct malloced_payload {
+    std::array<char, payload_size> data;
+};
+
+} // namespace
+
+template <>
+struct mcpp::is_huge_payload<mapped_payload> : std::true_type {};
+template <>
+struct mcpp::is_huge_payload<malloced_payload> : std::false_type {};
+
+namespace {
+
+auto page_size() -> std::size_t {
+#if defined(__unix__)
+    return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#else
+    return 4096;
+#endif
+}
+
+struct memory_usage {
+    long minor_faults;
+    long major_faults;
+    long rss_kib;
+};
+
+auto current_usage() -> memory_usage {
+    auto ret = memory_usage{0, 0, 0};
+#if defined(__unix__)
+    auto usage = rusage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    ret.minor_faults = usage.ru_minflt;
+    ret.major_faults = usage.ru_majflt;
+#endif
+    if (auto *statm = std::fopen("/proc/self/statm", "r")) {
+        auto pages = 0L;
+        auto resident = 0L;
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) == 2) {
+            ret.rss_kib = resident * static_cast<long>(page_size() / 1024);
+        }
+        std::fclose(statm);
+    }
+    return ret;
+}
+
+// Keeps a working set of large payloads alive and keeps replacing random ones, with small allocations in between
+// that outlive them, as a decoder handing out frames would.
+template <class Payload>
+void churn(const char *name) {
+    constexpr auto n_live = std::size_t{16};
+    constexpr auto n_ops = std::size_t{256};
+    auto rng = std::mt19937(42);
+    auto live = std::vector<unique_any>(n_live);
+    auto small = std::vector<std::unique_ptr<char[]>>();
+    auto stride = page_size();
+    auto n_calls = std::size_t{0};
+    auto before = current_usage();
+    bench::run(name, n_ops, [&] {
+        n_calls += 1;
+        for (auto i = std::size_t{0}; i < n_ops; ++i) {
+            auto &payload = live[rng() % n_live].template emplace<Payload>();
+            for (auto page = std::size_t{0}; page < payload_size; page += stride) {
+                payload.data[page] = 1;
+            }
+            small.push_back(std::make_unique<char[]>(64 + rng() % 4096));
+            bench::do_not_optimize(payload);
+        }
+    });
+    auto during = current_usage();
+    live.clear();
+    auto after = current_usage();
+    std::printf("    %.1f minor faults/op, %ld major faults, RSS %+ld MiB live, %+ld MiB after release\n",
+                static_cast<double>(during.minor_faults - before.minor_faults) / static_cast<double>(n_calls * n_ops),
+                during.major_faults - before.major_faults, (during.rss_kib - before.rss_kib) / 1024,
+                (after.rss_kib - before.rss_kib) / 1024);
+}
+
+} // namespace
+
+auto main() -> int {
+    std::printf("payloads of %zu MiB\n", payload_size >> 20);
+    churn<malloced_payload>("churn/malloc");
+    churn<mapped_payload>("churn/mmap");
+}
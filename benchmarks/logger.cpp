@@ -0,0 +1,42 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/async_logger.hpp"
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_records = std::size_t{1} << 14;
+
+} // namespace
+
+// Cost of a log call on the calling thread: formatting the line in place versus capturing the arguments for the
+// background thread of an async_logger.
+auto main() -> int {
+    auto user = std::string("alice");
+    bench::run("format on calling thread", n_records, [&] {
+        for (auto i = std::size_t{0}; i < n_records; ++i) {
+            auto stream = std::ostringstream();
+            stream << "request " << i << " from " << user << " took " << 1.5 << " ms";
+            auto line = stream.str();
+            bench::do_not_optimize(line.data());
+        }
+    });
+
+    // The rings are large enough for all runs, so that no record is dropped while the background thread catches up.
+    auto logger = async_logger([](const log_message &message) { bench::do_not_optimize(message.text.data()); },
+                               std::size_t{64} << 20);
+    bench::run("async_logger::log", n_records, [&] {
+        for (auto i = std::size_t{0}; i < n_records; ++i) {
+            logger.log(log_level::info, "request {} from {} took {} ms", i, user, 1.5);
+        }
+    });
+    logger.flush();
+    std::printf("dropped: %zu\n", logger.stats().dropped);
+}
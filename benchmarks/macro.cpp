@@ -0,0 +1,428 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <any>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Macrobenchmarks modeled on how services use type-erased messages, with std::any as the baseline. Unlike the
+// microbenchmarks, these include the allocator and cache effects of realistic type mixes and payload sizes:
+//   pipeline:  three threads passing messages through two bounded queues, one stage replacing some payloads
+//   context:   per-request context bags that are filled, looked up by type and destroyed
+//   container: a large container of mixed payloads, built, iterated with any_cast and destroyed
+//
+// Usage: bench-macro [--workload=all|pipeline|context|container] [--messages=N] [--requests=N] [--elements=N]
+//                    [--mix=scalar,quote,order,text] [--text-size=min,max]
+// The mix gives the relative frequency of each payload type; text payloads are strings of uniformly distributed length.
+
+using namespace mcpp;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct config {
+    std::string workload = "all";
+    std::size_t messages = 1000000;
+    std::size_t requests = 1000000;
+    std::size_t elements = 10000000;
+    std::array<double, 4> mix = {4, 3, 2, 1};
+    std::size_t min_text = 8;
+    std::size_t max_text = 256;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Payloads
+struct quote {
+    std::uint64_t instrument;
+    double bid;
+    double ask;
+};
+
+struct order {
+    std::uint64_t id;
+    std::uint64_t instrument;
+    double price;
+    std::uint64_t quantity;
+    char note[96];
+};
+
+template <class T, class Any>
+auto get_if(Any *any) noexcept -> T * {
+    if constexpr (std::is_same_v<std::remove_const_t<Any>, std::any>) {
+        return std::any_cast<T>(any);
+    } else {
+        return any_cast<T>(any);
+    }
+}
+
+class payload_generator {
+  public:
+    explicit payload_generator(const config &cfg, std::uint64_t seed)
+        : rng_(seed), type_(cfg.mix.begin(), cfg.mix.end()), text_size_(cfg.min_text, cfg.max_text) {}
+
+    template <class Any>
+    auto make(std::uint64_t i) -> Any {
+        switch (type_(rng_)) {
+            case 0:
+                return Any(std::uint64_t{i});
+            case 1:
+                return Any(quote{i, 1.0, 2.0});
+            case 2:
+                return Any(order{i, i, 1.0, 100, {}});
+            default:
+                return Any(std::string(text_size_(rng_), 'x'));
+        }
+    }
+
+    auto text() -> std::string { return std::string(text_size_(rng_), 'x'); }
+
+  private:
+    std::mt19937_64 rng_;
+    std::discrete_distribution<int> type_;
+    std::uniform_int_distribution<std::size_t> text_size_;
+};
+
+// Reads the payload the way a message handler would, by trying the types it knows.
+template <class Any>
+auto touch(const Any &any) -> std::uint64_t {
+    if (const auto *p = get_if<const std::uint64_t>(&any)) {
+        return *p;
+    }
+    if (const auto *p = get_if<const quote>(&any)) {
+        return p->instrument;
+    }
+    if (const auto *p = get_if<const order>(&any)) {
+        return p->quantity;
+    }
+    if (const auto *p = get_if<const std::string>(&any)) {
+        return p->size();
+    }
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reporting
+// Peak resident set size in MiB since the last reset_peak_rss(). Resetting needs Linux; elsewhere this is the peak of
+// the whole process so far.
+void reset_peak_rss() {
+#if defined(__linux__)
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+auto peak_rss_mib() -> double {
+#if defined(__linux__)
+    auto status = std::ifstream("/proc/self/status");
+    for (auto line = std::string(); std::getline(status, line);) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::strtod(line.c_str() + 6, nullptr) / 1024;
+        }
+    }
+    return -1;
+#elif defined(__APPLE__)
+    auto usage = rusage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / (1024 * 1024);
+#elif defined(__unix__)
+    auto usage = rusage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+#else
+    return -1;
+#endif
+}
+
+auto percentile(std::vector<std::int64_t> &latencies, double p) -> double {
+    if (latencies.empty()) {
+        return 0;
+    }
+    auto n = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1));
+    std::nth_element(latencies.begin(), latencies.begin() + static_cast<std::ptrdiff_t>(n), latencies.end());
+    return static_cast<double>(latencies[n]);
+}
+
+auto seconds_since(clock_type::time_point start) -> double {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+void report(const char *name, std::size_t n_ops, double seconds, std::vector<std::int64_t> &latencies) {
+    auto p50 = percentile(latencies, 0.5);
+    auto p99 = percentile(latencies, 0.99);
+    auto p999 = percentile(latencies, 0.999);
+    std::printf("%-28s %12.0f ops/s  p50 %8.0f ns  p99 %8.0f ns  p99.9 %8.0f ns  peak RSS %8.1f MiB\n", name,
+                static_cast<double>(n_ops) / seconds, p50, p99, p999, peak_rss_mib());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pipeline
+template <class Any>
+struct envelope {
+    clock_type::time_point created;
+    Any payload;
+};
+
+// Bounded single-producer/single-consumer queue of movable values.
+template <class T>
+class spsc_queue {
+  public:
+    explicit spsc_queue(std::size_t capacity) : slots_(capacity) {}
+
+    void push(T &&value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        while (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+            std::this_thread::yield();
+        }
+        slots_[tail % slots_.size()] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+    }
+
+    auto pop() -> T {
+        auto head = head_.load(std::memory_order_relaxed);
+        while (head == tail_.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        auto ret = std::move(slots_[head % slots_.size()]);
+        head_.store(head + 1, std::memory_order_release);
+        return ret;
+    }
+
+  private:
+    std::vector<T> slots_;
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    alignas(64) std::atomic<std::size_t> head_{0};
+};
+
+template <class Any>
+void run_pipeline(const char *name, const config &cfg) {
+    constexpr auto queue_capacity = std::size_t{1024};
+    reset_peak_rss();
+    auto first = spsc_queue<envelope<Any>>(queue_capacity);
+    auto second = spsc_queue<envelope<Any>>(queue_capacity);
+    auto latencies = std::vector<std::int64_t>(cfg.messages);
+    auto start = clock_type::now();
+
+    auto source = std::thread([&] {
+        auto gen = payload_generator(cfg, 1);
+        for (auto i = std::size_t{0}; i < cfg.messages; ++i) {
+            first.push({clock_type::now(), gen.template make<Any>(i)});
+        }
+    });
+    // Enriches quotes into orders, which replaces the payload with a larger one of a different type.
+    auto transform = std::thread([&] {
+        for (auto i = std::size_t{0}; i < cfg.messages; ++i) {
+            auto message = first.pop();
+            if (auto *q = get_if<quote>(&message.payload)) {
+                message.payload = Any(order{i, q->instrument, q->ask, 1, {}});
+            }
+            second.push(std::move(message));
+        }
+    });
+    auto checksum = std::uint64_t{0};
+    for (auto i = std::size_t{0}; i < cfg.messages; ++i) {
+        auto message = second.pop();
+        checksum += touch(message.payload);
+        latencies[i] = std::chrono::nanoseconds(clock_type::now() - message.created).count();
+    }
+    auto seconds = seconds_since(start);
+    source.join();
+    transform.join();
+    bench::do_not_optimize(checksum);
+    report(name, cfg.messages, seconds, latencies);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Context bag
+struct trace_span {
+    std::uint64_t trace_id;
+    std::uint64_t span_id;
+};
+
+// Per-request values looked up by their type, as in request contexts of RPC frameworks.
+template <class Any>
+class context_bag {
+  public:
+    template <class T>
+    void set(T value) {
+        for (auto &entry : entries_) {
+            if (auto *p = get_if<T>(&entry)) {
+                *p = std::move(value);
+                return;
+            }
+        }
+        entries_.emplace_back(std::move(value));
+    }
+
+    template <class T>
+    auto get() -> T * {
+        for (auto &entry : entries_) {
+            if (auto *p = get_if<T>(&entry)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+  private:
+    std::vector<Any> entries_;
+};
+
+template <class Any>
+void run_context(const char *name, const config &cfg) {
+    reset_peak_rss();
+    auto gen = payload_generator(cfg, 2);
+    auto latencies = std::vector<std::int64_t>(cfg.requests);
+    auto checksum = std::uint64_t{0};
+    auto start = clock_type::now();
+    for (auto i = std::size_t{0}; i < cfg.requests; ++i) {
+        auto request_start = clock_type::now();
+        {
+            auto bag = context_bag<Any>();
+            bag.set(std::uint64_t{i});
+            bag.set(request_start + std::chrono::milliseconds(100));
+            bag.set(trace_span{i, i + 1});
+            bag.set(gen.text());
+            bag.set(quote{i, 1.0, 2.0});
+            bag.set(order{i, i, 1.0, 1, {}});
+            for (auto j = 0; j < 4; ++j) {
+                checksum += *bag.template get<std::uint64_t>();
+                checksum += bag.template get<trace_span>()->span_id;
+                checksum += bag.template get<std::string>()->size();
+                checksum += bag.template get<order>()->quantity;
+            }
+            bag.set(trace_span{i, i + 2});
+            bag.set(gen.text());
+            checksum += bag.template get<double>() == nullptr ? 1 : 0;
+        }
+        latencies[i] = std::chrono::nanoseconds(clock_type::now() - request_start).count();
+    }
+    auto seconds = seconds_since(start);
+    bench::do_not_optimize(checksum);
+    report(name, cfg.requests, seconds, latencies);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Container
+template <class Any>
+void run_container(const char *name, const config &cfg) {
+    reset_peak_rss();
+    auto gen = payload_generator(cfg, 3);
+    auto start = clock_type::now();
+    auto anys = std::vector<Any>();
+    anys.reserve(cfg.elements);
+    for (auto i = std::size_t{0}; i < cfg.elements; ++i) {
+        anys.push_back(gen.template make<Any>(i));
+    }
+    auto build = seconds_since(start);
+    start = clock_type::now();
+    auto checksum = std::uint64_t{0};
+    for (const auto &any : anys) {
+        checksum += touch(any);
+    }
+    auto iterate = seconds_since(start);
+    bench::do_not_optimize(checksum);
+    auto rss = peak_rss_mib();
+    start = clock_type::now();
+    anys = std::vector<Any>();
+    auto destroy = seconds_since(start);
+    auto per_element = [&](double seconds) { return seconds * 1e9 / static_cast<double>(cfg.elements); };
+    std::printf("%-28s build %8.2f ns/elem  iterate %8.2f ns/elem  destroy %8.2f ns/elem  peak RSS %8.1f MiB\n", name,
+                per_element(build), per_element(iterate), per_element(destroy), rss);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Command line
+auto parse_list(const std::string &value, double *out, std::size_t n) -> bool {
+    const auto *p = value.c_str();
+    for (auto i = std::size_t{0}; i < n; ++i) {
+        char *end = nullptr;
+        out[i] = std::strtod(p, &end);
+        if (end == p || out[i] < 0 || (i + 1 < n ? *end != ',' : *end != '\0')) {
+            return false;
+        }
+        p = end + 1;
+    }
+    return true;
+}
+
+auto parse(int argc, char **argv, config &cfg) -> bool {
+    for (auto i = 1; i < argc; ++i) {
+        auto arg = std::string(argv[i]);
+        auto eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            return false;
+        }
+        auto key = arg.substr(2, eq - 2);
+        auto value = arg.substr(eq + 1);
+        if (key == "workload") {
+            cfg.workload = value;
+        } else if (key == "messages") {
+            cfg.messages = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "requests") {
+            cfg.requests = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "elements") {
+            cfg.elements = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "mix") {
+            if (!parse_list(value, cfg.mix.data(), cfg.mix.size()) ||
+                std::all_of(cfg.mix.begin(), cfg.mix.end(), [](double w) { return w == 0; })) {
+                return false;
+            }
+        } else if (key == "text-size") {
+            double sizes[2] = {};
+            if (!parse_list(value, sizes, 2) || sizes[0] > sizes[1]) {
+                return false;
+            }
+            cfg.min_text = static_cast<std::size_t>(sizes[0]);
+            cfg.max_text = static_cast<std::size_t>(sizes[1]);
+        } else {
+            return false;
+        }
+    }
+    return cfg.workload == "all" || cfg.workload == "pipeline" || cfg.workload == "context" ||
+           cfg.workload == "container";
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    auto cfg = config();
+    if (!parse(argc, argv, cfg)) {
+        std::fprintf(stderr, "usage: %s [--workload=all|pipeline|context|container] [--messages=N] [--requests=N] "
+                             "[--elements=N] [--mix=scalar,quote,order,text] [--text-size=min,max]\n",
+                     argv[0]);
+        return 1;
+    }
+    auto selected = [&](const char *workload) { return cfg.workload == "all" || cfg.workload == workload; };
+    if (selected("pipeline")) {
+        run_pipeline<std::any>("pipeline/std::any", cfg);
+        run_pipeline<unique_any>("pipeline/unique_any", cfg);
+    }
+    if (selected("context")) {
+        run_context<std::any>("context/std::any", cfg);
+        run_context<unique_any>("context/unique_any", cfg);
+    }
+    if (selected("container")) {
+        run_container<std::any>("container/std::any", cfg);
+        run_container<unique_any>("container/unique_any", cfg);
+    }
+}
@@ -0,0 +1,69 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/packed_any_vector.hpp"
+#include "mcpp/unique_any.hpp"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_elements = std::size_t{100'000};
+
+struct payload {
+    std::uint64_t value;
+    char padding[120];
+};
+
+} // namespace
+
+auto main() -> int {
+    // Other allocations of random sizes in between, as in a long-running process, scatter the payloads on the heap.
+    auto rng = std::mt19937_64(42);
+    auto noise = std::vector<std::unique_ptr<char[]>>();
+    auto anys = std::vector<unique_any>();
+    auto packed = packed_any_vector();
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        anys.emplace_back(payload{i, {}});
+        packed.push_back(payload{i, {}});
+        noise.emplace_back(new char[16 + rng() % 512]);
+        if (rng() % 2 == 0) {
+            noise[rng() % noise.size()].reset();
+        }
+    }
+
+    bench::run("build/vector<unique_any>", n_elements, [&] {
+        auto tmp = std::vector<unique_any>();
+        for (auto i = std::size_t{0}; i < n_elements; ++i) {
+            tmp.emplace_back(payload{i, {}});
+        }
+        bench::do_not_optimize(tmp.data());
+    });
+    bench::run("build/packed_any_vector", n_elements, [&] {
+        auto tmp = packed_any_vector();
+        for (auto i = std::size_t{0}; i < n_elements; ++i) {
+            tmp.push_back(payload{i, {}});
+        }
+        bench::do_not_optimize(tmp.size());
+    });
+    bench::run("iterate/vector<unique_any>", n_elements, [&] {
+        auto sum = std::uint64_t{0};
+        for (auto &any : anys) {
+            sum += any_cast<payload>(&any)->value;
+        }
+        bench::do_not_optimize(sum);
+    });
+    bench::run("iterate/packed_any_vector", n_elements, [&] {
+        auto sum = std::uint64_t{0};
+        for (auto ref : packed) {
+            sum += any_cast<payload>(&ref)->value;
+        }
+        bench::do_not_optimize(sum);
+    });
+}
@@ -0,0 +1,68 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/prefetch_ahead.hpp"
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+template <std::size_t Size>
+struct payload {
+    std::uint64_t value;
+    char padding[Size - sizeof(std::uint64_t)];
+};
+
+// Sums the payloads. Heap-placed payloads are scattered in memory, so each one is a likely cache miss.
+template <class Range>
+auto sum(Range &&range) -> std::uint64_t {
+    auto ret = std::uint64_t{0};
+    for (auto &any : range) {
+        if (auto *p = any_cast<payload<64>>(&any)) {
+            ret += p->value;
+        } else if (auto *p = any_cast<payload<256>>(&any)) {
+            ret += p->value;
+        } else if (auto *p = any_cast<std::uint64_t>(&any)) {
+            ret += *p;
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
+auto main() -> int {
+    constexpr auto n_elements = std::size_t{1} << 21;
+    auto rng = std::mt19937_64(42);
+    auto anys = std::vector<unique_any>();
+    anys.reserve(n_elements);
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        switch (rng() % 3) {
+            case 0:
+                anys.emplace_back(payload<64>{i, {}});
+                break;
+            case 1:
+                anys.emplace_back(payload<256>{i, {}});
+                break;
+            default:
+                anys.emplace_back(std::uint64_t{i});
+                break;
+        }
+    }
+    // Shuffling only swaps the heap pointers, so iteration order no longer matches allocation order.
+    std::shuffle(anys.begin(), anys.end(), rng);
+
+    bench::run("iterate", n_elements, [&] { bench::do_not_optimize(sum(anys)); });
+    for (auto distance : {4, 8, 16, 32}) {
+        static char name[64];
+        std::snprintf(name, sizeof(name), "iterate/prefetch_ahead(%d)", distance);
+        bench::run(name, n_elements, [&] { bench::do_not_optimize(sum(prefetch_ahead(anys, distance))); });
+    }
+}
@@ -0,0 +1,77 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/any_serialization.hpp"
+#include "mcpp/unique_any.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_elements = std::size_t{1} << 16;
+
+} // namespace
+
+// Serializable types need a unique type key, so they cannot be in an anonymous namespace.
+namespace market {
+
+struct quote {
+    std::uint64_t instrument;
+    double bid;
+    double ask;
+};
+
+struct trade {
+    std::uint64_t instrument;
+    double price;
+    std::uint64_t quantity;
+    std::uint64_t flags[4];
+};
+
+} // namespace market
+
+using namespace market;
+
+auto main() -> int {
+    register_serializable<std::uint64_t>();
+    register_serializable<quote>();
+    register_serializable<trade>();
+
+    auto rng = std::mt19937_64(42);
+    auto anys = std::vector<unique_any>();
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        switch (rng() % 3) {
+            case 0:
+                anys.emplace_back(std::uint64_t{i});
+                break;
+            case 1:
+                anys.emplace_back(quote{i, 1.0, 2.0});
+                break;
+            default:
+                anys.emplace_back(trade{i, 1.0, 100, {}});
+                break;
+        }
+    }
+
+    auto out = std::vector<std::byte>();
+    bench::run("serialize", n_elements, [&] {
+        out.clear();
+        for (const auto &any : anys) {
+            serialize(any, out);
+        }
+        bench::do_not_optimize(out.data());
+    });
+    bench::run("deserialize", n_elements, [&] {
+        auto in = byte_reader{out.data(), out.data() + out.size()};
+        for (auto &any : anys) {
+            any = deserialize(in);
+        }
+        bench::do_not_optimize(anys.data());
+    });
+}
@@ -0,0 +1,100 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/any_serialization.hpp"
+#include "mcpp/any_snapshot.hpp"
+#include "mcpp/unique_any.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_elements = std::size_t{1} << 16;
+
+} // namespace
+
+// Serializable types need a unique type key, so they cannot be in an anonymous namespace.
+namespace market {
+
+struct quote {
+    std::uint64_t instrument;
+    double bid;
+    double ask;
+};
+
+struct trade {
+    std::uint64_t instrument;
+    double price;
+    std::uint64_t quantity;
+    std::uint64_t flags[4];
+};
+
+} // namespace market
+
+using namespace market;
+
+// Compares restarting from a log, which rebuilds every unique_any, with mapping a snapshot and reading the payloads in
+// place.
+auto main() -> int {
+    register_serializable<std::uint64_t>();
+    register_serializable<quote>();
+    register_serializable<trade>();
+
+    auto rng = std::mt19937_64(42);
+    auto log = std::vector<std::byte>();
+    auto writer = snapshot_writer();
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        switch (rng() % 3) {
+            case 0:
+                serialize(unique_any(std::uint64_t{i}), log);
+                writer.push_back(std::uint64_t{i});
+                break;
+            case 1:
+                serialize(unique_any(quote{i, 1.0, 2.0}), log);
+                writer.push_back(quote{i, 1.0, 2.0});
+                break;
+            default:
+                serialize(unique_any(trade{i, 1.0, 100, {}}), log);
+                writer.push_back(trade{i, 1.0, 100, {}});
+                break;
+        }
+    }
+    auto path = std::string(P_tmpdir) + "/mcpp-bench-snapshot.bin";
+    writer.save(path);
+
+    bench::run("restart from log", n_elements, [&] {
+        auto anys = std::vector<unique_any>();
+        anys.reserve(n_elements);
+        auto in = byte_reader{log.data(), log.data() + log.size()};
+        while (in.remaining() != 0) {
+            anys.push_back(deserialize(in));
+        }
+        auto sum = std::uint64_t{0};
+        for (auto &any : anys) {
+            if (auto *q = any_cast<quote>(&any)) {
+                sum += q->instrument;
+            }
+        }
+        bench::do_not_optimize(&sum);
+    });
+    bench::run("restart from snapshot", n_elements, [&] {
+        auto snapshot = mapped_snapshot(path);
+        auto sum = std::uint64_t{0};
+        for (auto ref : snapshot) {
+            if (auto *q = any_cast<quote>(&ref)) {
+                sum += q->instrument;
+            }
+        }
+        bench::do_not_optimize(&sum);
+    });
+
+    std::remove(path.c_str());
+}
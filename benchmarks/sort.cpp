@@ -0,0 +1,88 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+#include "mcpp/any_sort.hpp"
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+constexpr auto n_elements = std::size_t{1} << 16;
+
+auto make_elements() -> std::vector<unique_any> {
+    auto rng = std::mt19937_64(42);
+    auto ret = std::vector<unique_any>();
+    ret.reserve(n_elements);
+    for (auto i = std::size_t{0}; i < n_elements; ++i) {
+        switch (rng() % 3) {
+            case 0:
+                ret.emplace_back(std::uint64_t{rng()});
+                break;
+            case 1:
+                ret.emplace_back(static_cast<double>(rng()));
+                break;
+            default:
+                ret.emplace_back(std::to_string(rng()));
+                break;
+        }
+    }
+    return ret;
+}
+
+// What sorting looks like without type-erased ordering: a chain of any_cast per element and type.
+auto rank(const unique_any &any) -> int {
+    if (any_cast<std::uint64_t>(&any) != nullptr) {
+        return 0;
+    }
+    if (any_cast<double>(&any) != nullptr) {
+        return 1;
+    }
+    return 2;
+}
+
+auto any_cast_less(const unique_any &lhs, const unique_any &rhs) -> bool {
+    auto lhs_rank = rank(lhs);
+    auto rhs_rank = rank(rhs);
+    if (lhs_rank != rhs_rank) {
+        return lhs_rank < rhs_rank;
+    }
+    switch (lhs_rank) {
+        case 0:
+            return *any_cast<std::uint64_t>(&lhs) < *any_cast<std::uint64_t>(&rhs);
+        case 1:
+            return *any_cast<double>(&lhs) < *any_cast<double>(&rhs);
+        default:
+            return *any_cast<std::string>(&lhs) < *any_cast<std::string>(&rhs);
+    }
+}
+
+// Each run shuffles the elements again, which is included in the timings.
+template <class Sort>
+void run_sort(const char *name, std::vector<unique_any> &elements, Sort sort) {
+    auto rng = std::mt19937_64(7);
+    bench::run(name, n_elements, [&] {
+        std::shuffle(elements.begin(), elements.end(), rng);
+        sort(elements.begin(), elements.end());
+        bench::do_not_optimize(elements.data());
+    });
+}
+
+} // namespace
+
+auto main() -> int {
+    auto elements = make_elements();
+    run_sort("shuffle_only", elements, [](auto /*first*/, auto /*last*/) {});
+    run_sort("std::sort/any_cast_chain", elements,
+             [](auto first, auto last) { std::sort(first, last, any_cast_less); });
+    run_sort("std::sort/any_less", elements, [](auto first, auto last) { std::sort(first, last, any_less()); });
+    run_sort("sort_any", elements, [](auto first, auto last) { sort_any(first, last); });
+    run_sort("stable_sort_any", elements, [](auto first, auto last) { stable_sort_any(first, last); });
+}
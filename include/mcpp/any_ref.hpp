@@ -0,0 +1,61 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/type_key.hpp"
+#include <any>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+
+namespace mcpp {
+
+// Non-owning, type-erased reference to an object of any type.
+//
+// Used to hand out payloads that live in storage owned by someone else, such as records in an any_ring. Like a
+// reference, it does not extend the lifetime of the object it refers to.
+class any_ref {
+  public:
+    constexpr any_ref() noexcept : type_(nullptr), key_(type_key_v<void>), ptr_(nullptr) {}
+    template <class T, class = std::enable_if_t<!std::is_const_v<T> && !std::is_same_v<T, any_ref>>>
+    explicit any_ref(T &value) noexcept : type_(&typeid(T)), key_(type_key_v<T>), ptr_(std::addressof(value)) {}
+    any_ref(const std::type_info &type, std::uint64_t key, void *ptr) noexcept : type_(&type), key_(key), ptr_(ptr) {}
+
+    [[nodiscard]] auto has_value() const noexcept -> bool { return ptr_ != nullptr; }
+    [[nodiscard]] auto type() const noexcept -> const std::type_info & {
+        return ptr_ != nullptr ? *type_ : typeid(void);
+    }
+    [[nodiscard]] auto type_key() const noexcept -> std::uint64_t { return ptr_ != nullptr ? key_ : type_key_v<void>; }
+
+  private:
+    template <typename T>
+    friend auto any_cast(any_ref *operand) noexcept -> T *;
+
+    const std::type_info *type_;
+    std::uint64_t key_;
+    void *ptr_;
+};
+
+template <class T>
+auto any_cast(any_ref *operand) noexcept -> T * {
+    static_assert(!std::is_reference_v<T>);
+    if (operand && operand->has_value() && detail::is_type<std::remove_cv_t<T>>(operand->key_, *operand->type_)) {
+        return static_cast<T *>(operand->ptr_);
+    }
+    return nullptr;
+}
+
+template <class T>
+auto any_cast(any_ref operand) -> T {
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    static_assert(std::is_constructible_v<T, U &>);
+    if (auto ptr = any_cast<U>(&operand)) {
+        return static_cast<T>(*ptr);
+    }
+    throw std::bad_any_cast();
+}
+
+} // namespace mcpp
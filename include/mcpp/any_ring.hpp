@@ -0,0 +1,198 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/any_ref.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+namespace mcpp {
+
+namespace detail {
+struct ring_vtable_type {
+    void (&destroy)(void *);
+    const std::type_info &typeinfo;
+    std::uint64_t key;
+};
+
+template <class T>
+struct ring_handler {
+  private:
+    static void destroy(void *p) { static_cast<T *>(p)->~T(); }
+
+  public:
+    static constexpr inline ring_vtable_type vtable = {destroy, typeid(T), type_key_v<T>};
+};
+
+// Every record starts with this header. A null vtable marks padding up to the end of the buffer.
+struct ring_record {
+    const ring_vtable_type *vtable;
+    std::uint32_t size;           // Size of the whole record including header and padding
+    std::uint32_t payload_offset; // Offset of the payload from the start of the record
+};
+
+constexpr inline std::size_t ring_record_alignment = 16;
+constexpr inline std::size_t ring_buffer_alignment = 64;
+static_assert(sizeof(ring_record) <= ring_record_alignment);
+
+constexpr auto align_up(std::size_t n, std::size_t alignment) -> std::size_t {
+    return (n + alignment - 1) / alignment * alignment;
+}
+} // namespace detail
+
+// Single-producer/single-consumer ring buffer of heterogeneous payloads.
+//
+// Each record is a small header (vtable and size) followed by the payload, constructed in place at its exact size and
+// alignment. Unlike a queue of unique_any, payloads never go to the heap, and producer and consumer both walk through
+// sequential memory.
+//
+// One thread may call the producer functions (try_emplace, try_push) and one other thread the consumer functions
+// (try_consume, empty) concurrently, without locks. Payload alignment is limited to 64 bytes.
+class any_ring {
+  public:
+    // The capacity is rounded up to a multiple of 16 bytes. A payload only fits if its record (payload plus 16 byte
+    // header plus alignment padding) fits into the capacity. Such a record can always be pushed into an empty ring.
+    explicit any_ring(std::size_t capacity)
+        : capacity_(detail::align_up(capacity, detail::ring_record_alignment)),
+          buffer_(static_cast<std::byte *>(
+              ::operator new(capacity_, std::align_val_t{detail::ring_buffer_alignment}))) {}
+    any_ring(const any_ring &other) = delete;
+    any_ring(any_ring &&other) = delete;
+    auto operator=(const any_ring &rhs) -> any_ring & = delete;
+    auto operator=(any_ring &&rhs) -> any_ring & = delete;
+    ~any_ring() {
+        while (try_consume([](any_ref /*unused*/) {})) {
+        }
+        ::operator delete(buffer_, std::align_val_t{detail::ring_buffer_alignment});
+    }
+
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t { return capacity_; }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Producer
+    // Constructs a T in place at the end of the ring. Returns nullptr if there is not enough space.
+    template <class T, class... Args>
+    auto try_emplace(Args &&...args) -> T * {
+        static_assert(alignof(T) <= detail::ring_buffer_alignment);
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto pos = tail % capacity_;
+        auto payload_offset = payload_offset_at<T>(pos);
+        auto size = detail::align_up(payload_offset + sizeof(T), detail::ring_record_alignment);
+        auto skip = std::size_t{0};
+        if (capacity_ - pos < size) {
+            // Does not fit before the end of the buffer, pad and start over at the beginning.
+            skip = capacity_ - pos;
+            payload_offset = payload_offset_at<T>(0);
+            size = detail::align_up(payload_offset + sizeof(T), detail::ring_record_alignment);
+        }
+        if (size > capacity_) {
+            return nullptr;
+        }
+        auto pad = skip != 0;
+        if (!reserve(tail, skip + size)) {
+            // Padding and record together may not fit even into an empty ring. But then the whole buffer is free, so
+            // jump to its start without padding and tell the consumer where the jump happened.
+            if (!pad || cached_head_ != tail) {
+                return nullptr;
+            }
+            wrapped_at_.store(tail, std::memory_order_relaxed);
+            pad = false;
+        }
+        if (pad) {
+            auto padding = detail::ring_record{nullptr, static_cast<std::uint32_t>(skip), 0};
+            ::new (static_cast<void *>(buffer_ + pos)) detail::ring_record(padding);
+        }
+        if (skip != 0) {
+            pos = 0;
+        }
+        auto *ret = ::new (static_cast<void *>(buffer_ + pos + payload_offset)) T(std::forward<Args>(args)...);
+        ::new (static_cast<void *>(buffer_ + pos)) detail::ring_record{
+            &detail::ring_handler<T>::vtable, static_cast<std::uint32_t>(size),
+            static_cast<std::uint32_t>(payload_offset)};
+        tail_.store(tail + skip + size, std::memory_order_release);
+        return ret;
+    }
+
+    template <class ValueType, class T = std::decay_t<ValueType>>
+    auto try_push(ValueType &&value) -> bool {
+        return try_emplace<T>(std::forward<ValueType>(value)) != nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Consumer
+    // Calls f with a reference to the oldest payload, then destroys it. Returns false if the ring is empty.
+    template <class F>
+    auto try_consume(F &&f) -> bool {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+            // The producer only wraps around without padding when the ring is empty, so only right after catching up.
+            if (head == wrapped_at_.load(std::memory_order_relaxed)) {
+                head += capacity_ - head % capacity_;
+            }
+        }
+        auto *record = record_at(head % capacity_);
+        if (record->vtable == nullptr) {
+            head += record->size;
+            record = record_at(head % capacity_);
+        }
+        auto *payload = reinterpret_cast<std::byte *>(record) + record->payload_offset;
+        auto release = [&, next = head + record->size] {
+            record->vtable->destroy(payload);
+            head_.store(next, std::memory_order_release);
+        };
+        struct guard {
+            decltype(release) &fn;
+            ~guard() { fn(); }
+        } g{release};
+        std::forward<F>(f)(any_ref(record->vtable->typeinfo, record->vtable->key, payload));
+        return true;
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+  private:
+    template <class T>
+    auto payload_offset_at(std::size_t pos) const noexcept -> std::size_t {
+        return detail::align_up(pos + sizeof(detail::ring_record), alignof(T)) - pos;
+    }
+
+    auto record_at(std::size_t pos) const noexcept -> detail::ring_record * {
+        return std::launder(reinterpret_cast<detail::ring_record *>(buffer_ + pos));
+    }
+
+    auto reserve(std::size_t tail, std::size_t size) noexcept -> bool {
+        if (tail + size - cached_head_ > capacity_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail + size - cached_head_ > capacity_) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::size_t capacity_;
+    std::byte *const buffer_;
+    // Producer and consumer positions are monotonic byte counters, each on its own cache line together with the
+    // other side's last observed position.
+    alignas(64) std::atomic<std::size_t> tail_{0};
+    std::size_t cached_head_ = 0;
+    // Position at which the producer last wrapped around without a padding record, published by tail_.
+    std::atomic<std::size_t> wrapped_at_{~std::size_t{0}};
+    alignas(64) std::atomic<std::size_t> head_{0};
+    std::size_t cached_tail_ = 0;
+};
+
+} // namespace mcpp
@@ -0,0 +1,186 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/type_key.hpp"
+#include "mcpp/unique_any.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mcpp {
+
+// Customization point: specialize for payload types that are not trivially copyable to make them serializable. The
+// specialization needs
+//   static void encode(const T &value, std::vector<std::byte> &out); // Appends the encoded value to out
+//   static auto decode(const std::byte *data, std::size_t size) -> T; // Decodes what encode() appended
+// Trivially copyable types are copied bytewise and do not need a specialization.
+template <class T>
+struct serialize_traits {};
+
+class serialization_error : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+// Input position for deserialize().
+struct byte_reader {
+    const std::byte *pos;
+    const std::byte *end;
+
+    [[nodiscard]] auto remaining() const noexcept -> std::size_t { return static_cast<std::size_t>(end - pos); }
+    // Returns a pointer to the next size bytes and skips them.
+    auto take(std::size_t size) -> const std::byte * {
+        if (size > remaining()) {
+            throw serialization_error("mcpp::deserialize: unexpected end of input");
+        }
+        auto *ret = pos;
+        pos += size;
+        return ret;
+    }
+};
+
+namespace detail {
+// Every serialized object starts with its type key and the size of the encoded payload, in host byte order.
+struct serialized_header {
+    std::uint64_t key;
+    std::uint64_t size;
+};
+
+template <class T, class = void>
+constexpr inline bool has_serialize_traits_v = false;
+template <class T>
+constexpr inline bool has_serialize_traits_v<
+    T, std::void_t<decltype(&serialize_traits<T>::encode), decltype(&serialize_traits<T>::decode)>> = true;
+
+struct serializer_entry {
+    void (*encode)(const void *, std::vector<std::byte> &);
+    void (*decode)(const std::byte *, std::size_t, unique_any &);
+};
+
+template <class T>
+void encode_payload(const void *payload, std::vector<std::byte> &out) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        auto *bytes = static_cast<const std::byte *>(payload);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    } else {
+        serialize_traits<T>::encode(*static_cast<const T *>(payload), out);
+    }
+}
+
+// Constructs the payload directly in the object's storage, see unique_any::emplace_from().
+template <class T>
+void decode_payload(const std::byte *data, std::size_t size, unique_any &any) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        if (size != sizeof(T)) {
+            throw serialization_error("mcpp::deserialize: payload size mismatch");
+        }
+        if constexpr (std::is_default_constructible_v<T>) {
+            std::memcpy(static_cast<void *>(&any.emplace<T>()), data, sizeof(T));
+        } else {
+            any.emplace_from([&] {
+                alignas(T) unsigned char raw[sizeof(T)];
+                std::memcpy(raw, data, sizeof(T));
+                return *std::launder(reinterpret_cast<const T *>(raw));
+            });
+        }
+    } else {
+        any.emplace_from([&] { return serialize_traits<T>::decode(data, size); });
+    }
+}
+} // namespace detail
+
+// Opt-in mapping from type keys to the functions that encode and decode payloads of that type.
+//
+// Types are identified by type_key_v, so the serialized form can be read by any build of the same program that
+// registers the same types, across shared libraries and restarts. Only types with a unique key can be registered, see
+// has_unique_type_key_v. The encoding is in host byte order and not meant to
+// be exchanged between different architectures. Registration is not thread-safe and should happen at startup, before
+// any concurrent serialization.
+class serialization_registry {
+  public:
+    // Registers T, which must be trivially copyable or have a serialize_traits specialization.
+    template <class T>
+    void add() {
+        static_assert(std::is_trivially_copyable_v<T> || detail::has_serialize_traits_v<T>,
+                      "T must be trivially copyable or specialize mcpp::serialize_traits");
+        static_assert(has_unique_type_key_v<T>, "T must have a unique type key, see mcpp::has_unique_type_key_v");
+        entries_[type_key_v<T>] = {detail::encode_payload<T>, detail::decode_payload<T>};
+    }
+    template <class T>
+    [[nodiscard]] auto contains() const -> bool {
+        return entries_.count(type_key_v<T>) != 0;
+    }
+
+    // Appends the type key, size and encoded payload of any to out. Empty objects are written with type_key_v<void>.
+    // Throws serialization_error if the payload type is not registered. If anything throws, out is left unchanged.
+    template <std::size_t Size, std::size_t Align, class Dispatch>
+    void serialize(const basic_unique_any<Size, Align, Dispatch> &any, std::vector<std::byte> &out) const {
+        auto header = detail::serialized_header{any.type_key(), 0};
+        const auto *entry = any.has_value() ? &find(header.key) : nullptr;
+        auto header_pos = out.size();
+        out.resize(header_pos + sizeof(header));
+        if (entry != nullptr) {
+            try {
+                entry->encode(detail::payload_access::get(any), out);
+            } catch (...) {
+                out.resize(header_pos);
+                throw;
+            }
+            header.size = out.size() - header_pos - sizeof(header);
+        }
+        std::memcpy(out.data() + header_pos, &header, sizeof(header));
+    }
+
+    // Reads an object written by serialize() and advances in past it. Throws serialization_error if the input is
+    // truncated or the payload type is not registered.
+    [[nodiscard]] auto deserialize(byte_reader &in) const -> unique_any {
+        auto header = detail::serialized_header{};
+        std::memcpy(&header, in.take(sizeof(header)), sizeof(header));
+        auto ret = unique_any();
+        if (header.key != type_key_v<void>) {
+            auto *data = in.take(header.size);
+            find(header.key).decode(data, header.size, ret);
+        }
+        return ret;
+    }
+
+    // Registry used by the free functions serialize() and deserialize().
+    static auto global() -> serialization_registry & {
+        static auto instance = serialization_registry();
+        return instance;
+    }
+
+  private:
+    auto find(std::uint64_t key) const -> const detail::serializer_entry & {
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            throw serialization_error("mcpp::serialization_registry: payload type is not registered");
+        }
+        return it->second;
+    }
+
+    std::unordered_map<std::uint64_t, detail::serializer_entry> entries_;
+};
+
+// Registers T with the global registry.
+template <class T>
+void register_serializable() {
+    serialization_registry::global().add<T>();
+}
+
+template <std::size_t Size, std::size_t Align, class Dispatch>
+void serialize(const basic_unique_any<Size, Align, Dispatch> &any, std::vector<std::byte> &out) {
+    serialization_registry::global().serialize(any, out);
+}
+
+inline auto deserialize(byte_reader &in) -> unique_any { return serialization_registry::global().deserialize(in); }
+
+} // namespace mcpp
@@ -0,0 +1,333 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/type_key.hpp"
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mcpp {
+
+class snapshot_error : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+// The file starts with this header, followed by the records. All fields are in host byte order; the byte order mark
+// rejects snapshots written on a machine with a different one.
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t count;     // Number of records
+    std::uint64_t data_size; // Size of the records, not including this header
+};
+
+constexpr inline char snapshot_magic[8] = {'m', 'c', 'p', 'p', 's', 'n', 'a', 'p'};
+constexpr inline std::uint32_t snapshot_version = 1;
+constexpr inline std::uint32_t snapshot_byte_order = 0x01020304;
+
+// Every record starts at a multiple of 16 bytes from the start of the file with this header, followed by the payload at
+// payload_offset. The payload is aligned for its type relative to the start of the file, which is page-aligned when
+// mapped, so alignments of up to 64 bytes are supported.
+struct snapshot_record {
+    std::uint64_t key;
+    std::uint32_t size;           // Size of the payload
+    std::uint32_t payload_offset; // Offset of the payload from the start of the record
+};
+
+constexpr inline std::size_t snapshot_record_alignment = 16;
+constexpr inline std::size_t snapshot_max_alignment = 64;
+static_assert(sizeof(snapshot_header) % snapshot_record_alignment == 0);
+static_assert(sizeof(snapshot_record) == snapshot_record_alignment);
+
+constexpr auto snapshot_align_up(std::size_t n, std::size_t alignment) -> std::size_t {
+    return (n + alignment - 1) / alignment * alignment;
+}
+} // namespace detail
+
+// Non-owning, read-only view of one payload in a snapshot. Like any_ref, but payloads in a snapshot have no
+// std::type_info, only their type key.
+class snapshot_ref {
+  public:
+    snapshot_ref(std::uint64_t key, const void *ptr, std::size_t size) noexcept : key_(key), ptr_(ptr), size_(size) {}
+
+    [[nodiscard]] auto type_key() const noexcept -> std::uint64_t { return key_; }
+    [[nodiscard]] auto data() const noexcept -> const void * { return ptr_; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }
+
+  private:
+    std::uint64_t key_;
+    const void *ptr_;
+    std::size_t size_;
+};
+
+// Matches the payload by type key and size only. snapshot_writer only accepts types with a unique type key, so the key
+// identifies the type in every program built with the same compiler.
+template <class T>
+auto any_cast(const snapshot_ref *operand) noexcept -> const T * {
+    static_assert(!std::is_reference_v<T>);
+    if (operand && operand->type_key() == type_key_v<std::remove_cv_t<T>> && operand->size() == sizeof(T)) {
+        return static_cast<const T *>(operand->data());
+    }
+    return nullptr;
+}
+
+template <class T>
+auto any_cast(const snapshot_ref &operand) -> T {
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    static_assert(std::is_constructible_v<T, const U &>);
+    if (auto ptr = any_cast<U>(&operand)) {
+        return static_cast<T>(*ptr);
+    }
+    throw std::bad_any_cast();
+}
+
+// Builds a snapshot of trivially copyable payloads in memory, whose bytes can be written to a file and later used in
+// place through snapshot_view or mapped_snapshot, without any deserialization.
+//
+// Payloads are identified by type_key_v, so a snapshot can be read by every build of a program made with the same
+// compiler. Types without a unique type key, such as lambdas and types in anonymous namespaces, are rejected at
+// compile time. Payload types must not contain pointers into the writing process.
+class snapshot_writer {
+  public:
+    snapshot_writer() : data_(sizeof(detail::snapshot_header)) {}
+
+    template <class T>
+    void push_back(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>, "snapshots can only hold trivially copyable payloads");
+        static_assert(alignof(T) <= detail::snapshot_max_alignment);
+        static_assert(sizeof(T) <= std::numeric_limits<std::uint32_t>::max());
+        static_assert(has_unique_type_key_v<T>, "T must have a unique type key, see mcpp::has_unique_type_key_v");
+        auto record_pos = data_.size();
+        auto payload_offset =
+            detail::snapshot_align_up(record_pos + sizeof(detail::snapshot_record), alignof(T)) - record_pos;
+        auto record_size =
+            detail::snapshot_align_up(payload_offset + sizeof(T), detail::snapshot_record_alignment);
+        data_.resize(record_pos + record_size);
+        auto record = detail::snapshot_record{type_key_v<T>, static_cast<std::uint32_t>(sizeof(T)),
+                                              static_cast<std::uint32_t>(payload_offset)};
+        std::memcpy(data_.data() + record_pos, &record, sizeof(record));
+        std::memcpy(data_.data() + record_pos + payload_offset, &value, sizeof(T));
+        count_ += 1;
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return count_; }
+
+    // The complete snapshot, including its header.
+    [[nodiscard]] auto bytes() -> const std::vector<std::byte> & {
+        auto header = detail::snapshot_header{{}, detail::snapshot_version, detail::snapshot_byte_order, count_,
+                                              data_.size() - sizeof(detail::snapshot_header)};
+        std::memcpy(header.magic, detail::snapshot_magic, sizeof(header.magic));
+        std::memcpy(data_.data(), &header, sizeof(header));
+        return data_;
+    }
+
+    // Writes the snapshot to a file, replacing it if it exists.
+    void save(const std::string &path) {
+        const auto &data = bytes();
+        auto file = std::unique_ptr<std::FILE, int (*)(std::FILE *)>(std::fopen(path.c_str(), "wb"), std::fclose);
+        if (!file || std::fwrite(data.data(), 1, data.size(), file.get()) != data.size() ||
+            std::fclose(file.release()) != 0) {
+            throw snapshot_error("mcpp::snapshot_writer: cannot write " + path);
+        }
+    }
+
+  private:
+    std::vector<std::byte> data_;
+    std::uint64_t count_ = 0;
+};
+
+// Read-only view of a snapshot in memory. The memory must stay valid while the view is used, and be aligned to
+// 64 bytes for the payloads to be aligned.
+class snapshot_view {
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = snapshot_ref;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = snapshot_ref;
+
+        iterator() = default;
+
+        auto operator*() const noexcept -> snapshot_ref {
+            auto record = detail::snapshot_record{};
+            std::memcpy(&record, pos_, sizeof(record));
+            return snapshot_ref(record.key, pos_ + record.payload_offset, record.size);
+        }
+        auto operator++() noexcept -> iterator & {
+            auto record = detail::snapshot_record{};
+            std::memcpy(&record, pos_, sizeof(record));
+            pos_ += detail::snapshot_align_up(record.payload_offset + std::size_t{record.size},
+                                              detail::snapshot_record_alignment);
+            return *this;
+        }
+        auto operator++(int) noexcept -> iterator {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        friend auto operator==(const iterator &lhs, const iterator &rhs) noexcept -> bool {
+            return lhs.pos_ == rhs.pos_;
+        }
+        friend auto operator!=(const iterator &lhs, const iterator &rhs) noexcept -> bool {
+            return lhs.pos_ != rhs.pos_;
+        }
+
+      private:
+        friend class snapshot_view;
+        explicit iterator(const std::byte *pos) noexcept : pos_(pos) {}
+        const std::byte *pos_ = nullptr;
+    };
+
+    // Checks the header, but not the records, so that opening a large snapshot does not touch all of its pages. Call
+    // validate() before iterating snapshots from untrusted sources.
+    snapshot_view(const void *data, std::size_t size) : data_(static_cast<const std::byte *>(data)) {
+        if (size < sizeof(detail::snapshot_header)) {
+            throw snapshot_error("mcpp::snapshot_view: truncated header");
+        }
+        std::memcpy(&header_, data_, sizeof(header_));
+        if (std::memcmp(header_.magic, detail::snapshot_magic, sizeof(header_.magic)) != 0 ||
+            header_.version != detail::snapshot_version || header_.byte_order != detail::snapshot_byte_order) {
+            throw snapshot_error("mcpp::snapshot_view: not a compatible snapshot");
+        }
+        if (header_.data_size > size - sizeof(detail::snapshot_header)) {
+            throw snapshot_error("mcpp::snapshot_view: truncated data");
+        }
+    }
+
+    // Walks all records and throws snapshot_error if any of them is out of bounds or malformed.
+    void validate() const {
+        auto pos = sizeof(detail::snapshot_header);
+        auto end = pos + header_.data_size;
+        auto count = std::uint64_t{0};
+        while (pos != end) {
+            auto record = detail::snapshot_record{};
+            if (end - pos < sizeof(record)) {
+                throw snapshot_error("mcpp::snapshot_view: truncated record");
+            }
+            std::memcpy(&record, data_ + pos, sizeof(record));
+            auto record_size = detail::snapshot_align_up(record.payload_offset + std::size_t{record.size},
+                                                         detail::snapshot_record_alignment);
+            if (record.payload_offset < sizeof(record) || record_size > end - pos) {
+                throw snapshot_error("mcpp::snapshot_view: malformed record");
+            }
+            pos += record_size;
+            count += 1;
+        }
+        if (count != header_.count) {
+            throw snapshot_error("mcpp::snapshot_view: record count mismatch");
+        }
+    }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return static_cast<std::size_t>(header_.count); }
+    [[nodiscard]] auto empty() const noexcept -> bool { return header_.count == 0; }
+    [[nodiscard]] auto begin() const noexcept -> iterator { return iterator(data_ + sizeof(detail::snapshot_header)); }
+    [[nodiscard]] auto end() const noexcept -> iterator {
+        return iterator(data_ + sizeof(detail::snapshot_header) + header_.data_size);
+    }
+
+  private:
+    const std::byte *data_;
+    detail::snapshot_header header_;
+};
+
+// Snapshot file mapped read-only into memory. Pages are only loaded when their records are accessed. On platforms
+// without mmap, the file is read into memory instead.
+class mapped_snapshot {
+  public:
+    explicit mapped_snapshot(const std::string &path) : view_(open(path)) {}
+    mapped_snapshot(const mapped_snapshot &other) = delete;
+    auto operator=(const mapped_snapshot &rhs) -> mapped_snapshot & = delete;
+    ~mapped_snapshot() { release(data_, size_); }
+
+    [[nodiscard]] auto view() const noexcept -> const snapshot_view & { return view_; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return view_.size(); }
+    [[nodiscard]] auto begin() const noexcept -> snapshot_view::iterator { return view_.begin(); }
+    [[nodiscard]] auto end() const noexcept -> snapshot_view::iterator { return view_.end(); }
+
+  private:
+    // Maps the file and constructs the view, releasing the mapping if the header is invalid.
+    auto open(const std::string &path) -> snapshot_view {
+        load(path);
+        try {
+            return snapshot_view(data_, size_);
+        } catch (...) {
+            release(data_, size_);
+            throw;
+        }
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    void load(const std::string &path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw snapshot_error("mcpp::mapped_snapshot: cannot open " + path);
+        }
+        struct ::stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw snapshot_error("mcpp::mapped_snapshot: cannot stat " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        auto *mapped = size_ == 0 ? MAP_FAILED : ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw snapshot_error("mcpp::mapped_snapshot: cannot map " + path);
+        }
+        data_ = mapped;
+    }
+
+    static void release(void *data, std::size_t size) noexcept { ::munmap(data, size); }
+#else
+    void load(const std::string &path) {
+        auto file = std::unique_ptr<std::FILE, int (*)(std::FILE *)>(std::fopen(path.c_str(), "rb"), std::fclose);
+        if (!file || std::fseek(file.get(), 0, SEEK_END) != 0) {
+            throw snapshot_error("mcpp::mapped_snapshot: cannot open " + path);
+        }
+        auto size = std::ftell(file.get());
+        if (size <= 0 || std::fseek(file.get(), 0, SEEK_SET) != 0) {
+            throw snapshot_error("mcpp::mapped_snapshot: cannot read " + path);
+        }
+        size_ = static_cast<std::size_t>(size);
+        data_ = ::operator new(size_, std::align_val_t{detail::snapshot_max_alignment});
+        if (std::fread(data_, 1, size_, file.get()) != size_) {
+            release(data_, size_);
+            throw snapshot_error("mcpp::mapped_snapshot: cannot read " + path);
+        }
+    }
+
+    static void release(void *data, std::size_t /*unused*/) noexcept {
+        ::operator delete(data, std::align_val_t{detail::snapshot_max_alignment});
+    }
+#endif
+
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+    snapshot_view view_;
+};
+
+} // namespace mcpp
@@ -0,0 +1,58 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+namespace mcpp {
+
+namespace detail {
+// First groups the objects by type, then sorts each run of the same type by its payload's operator<, which is looked
+// up once per run instead of once per comparison.
+template <class RandomIt, class Sort>
+void sort_by_type_runs(RandomIt first, RandomIt last, Sort sort) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                    typename std::iterator_traits<RandomIt>::iterator_category>);
+
+    sort(first, last, [](const value_type &lhs, const value_type &rhs) { return compare_types(lhs, rhs) < 0; });
+    while (first != last) {
+        auto run_end = std::find_if(std::next(first), last,
+                                    [&](const value_type &value) { return compare_types(*first, value) != 0; });
+        if (first->has_value() && run_end - first > 1) {
+            const auto &handle = payload_access::handle(*first);
+            auto *less = handle.less_function();
+            if (less == nullptr) {
+                throw std::logic_error("mcpp::unique_any: payload type is not less-than comparable");
+            }
+            auto is_inline = handle.is_inline();
+            sort(first, run_end, [less, is_inline](const value_type &lhs, const value_type &rhs) {
+                return less(payload_access::get(lhs, is_inline), payload_access::get(rhs, is_inline));
+            });
+        }
+        first = run_end;
+    }
+}
+} // namespace detail
+
+// Sorts a range of unique_any into the order of three_way_compare(), so that objects with payloads of the same type
+// form contiguous runs. Faster than sorting with any_less, because only the grouping by type compares type keys, and
+// each run is sorted with a direct call to its payload's operator<.
+template <class RandomIt>
+void sort_any(RandomIt first, RandomIt last) {
+    detail::sort_by_type_runs(first, last, [](auto begin, auto end, auto less) { std::sort(begin, end, less); });
+}
+
+// Like sort_any(), but keeps the order of equivalent objects.
+template <class RandomIt>
+void stable_sort_any(RandomIt first, RandomIt last) {
+    detail::sort_by_type_runs(first, last, [](auto begin, auto end, auto less) { std::stable_sort(begin, end, less); });
+}
+
+} // namespace mcpp
@@ -0,0 +1,344 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/any_ref.hpp"
+#include "mcpp/any_ring.hpp"
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mcpp {
+
+enum class log_level : std::uint8_t { trace, debug, info, warning, error };
+
+constexpr auto to_string(log_level level) noexcept -> std::string_view {
+    switch (level) {
+        case log_level::trace:
+            return "trace";
+        case log_level::debug:
+            return "debug";
+        case log_level::info:
+            return "info";
+        case log_level::warning:
+            return "warning";
+        case log_level::error:
+            return "error";
+    }
+    return "unknown";
+}
+
+// Customization point: specialize to control how arguments of type T are formatted. The default handles strings,
+// characters, booleans and numbers, and falls back to operator<<.
+template <class T>
+struct log_formatter {
+    static void format(std::string &out, const T &value) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            out += value;
+        } else if constexpr (std::is_same_v<T, char>) {
+            out += value;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            out += value ? "true" : "false";
+        } else if constexpr (std::is_integral_v<T>) {
+            char buffer[24];
+            auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+            out.append(buffer, result.ptr);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            // The shortest representation that reads back as the same value.
+#if defined(__cpp_lib_to_chars)
+            char buffer[64];
+            auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+            out.append(buffer, result.ptr);
+#else
+            char buffer[64];
+            auto wide = static_cast<long double>(value);
+            auto n = std::snprintf(buffer, sizeof(buffer), "%.*Lg", std::numeric_limits<T>::digits10, wide);
+            if (static_cast<T>(std::strtold(buffer, nullptr)) != value) {
+                n = std::snprintf(buffer, sizeof(buffer), "%.*Lg", std::numeric_limits<T>::max_digits10, wide);
+            }
+            out.append(buffer, static_cast<std::size_t>(n));
+#endif
+        } else {
+            auto stream = std::ostringstream();
+            stream << value;
+            out += stream.str();
+        }
+    }
+};
+
+// What the sink of an async_logger receives for each record. The text is only valid during the call.
+struct log_message {
+    log_level level;
+    std::chrono::system_clock::time_point time;
+    std::string_view text;
+};
+
+namespace detail {
+// Arguments are captured by value. C strings and string views are copied into a std::string, since what they point to
+// is usually gone by the time the record is formatted.
+template <class T>
+using log_capture_t =
+    std::conditional_t<std::is_convertible_v<const std::decay_t<T> &, std::string_view> &&
+                           !std::is_same_v<std::decay_t<T>, std::string>,
+                       std::string, std::decay_t<T>>;
+
+// Slot for one captured argument. It is large enough to hold a std::string inline, so short strings and all scalars are
+// captured without allocating.
+using log_value = basic_unique_any<sizeof(std::string), alignof(std::string), vtable_dispatch>;
+
+template <class T>
+void format_log_value(std::string &out, const log_value &value) {
+    log_formatter<T>::format(out, *any_cast<T>(&value));
+}
+
+struct log_argument {
+    template <class Arg, class T = log_capture_t<Arg>>
+    explicit log_argument(Arg &&arg)
+        : format(format_log_value<T>), value(std::in_place_type<T>, std::forward<Arg>(arg)) {}
+
+    void (*format)(std::string &, const log_value &);
+    log_value value;
+};
+
+constexpr inline std::size_t max_log_arguments = 8;
+
+// Records are constructed in place in the calling thread's ring, so their arguments are never moved again.
+template <std::size_t N>
+struct log_record {
+    template <class... Args>
+    log_record(log_level level, const char *format, Args &&...args)
+        : level(level), time(std::chrono::system_clock::now()), format(format),
+          args{log_argument(std::forward<Args>(args))...} {}
+
+    // Replaces each {} in the format string with the next argument. Arguments without a placeholder are appended,
+    // separated by spaces.
+    void format_to(std::string &out) const {
+        auto i = std::size_t{0};
+        for (const auto *p = format; *p != '\0'; ++p) {
+            if (p[0] == '{' && p[1] == '}' && i < N) {
+                args[i].format(out, args[i].value);
+                ++i;
+                ++p;
+            } else {
+                out += *p;
+            }
+        }
+        for (; i < N; ++i) {
+            out += ' ';
+            args[i].format(out, args[i].value);
+        }
+    }
+
+    log_level level;
+    std::chrono::system_clock::time_point time;
+    const char *format;
+    std::array<log_argument, N> args;
+};
+} // namespace detail
+
+// Logger that moves formatting off the calling threads.
+//
+// log() captures the arguments by value into small inline unique_any slots and constructs the record in place in a
+// lock-free ring owned by the calling thread; a background thread takes the records out of all rings, formats them and
+// hands them to the sink. Records from one thread are delivered in order, records from different threads are not
+// ordered relative to each other. The background thread polls every millisecond while there are records, and backs off
+// to every 32 milliseconds while the logger is idle; flush() wakes it up immediately.
+//
+// The format string must outlive the logger, so it should be a string literal. Each thread gets its ring on its first
+// call to log(); rings live until the logger is destroyed. When a thread's ring is full, its records are dropped and
+// counted rather than blocking the caller.
+class async_logger {
+  public:
+    using sink_type = std::function<void(const log_message &)>;
+
+    struct stats_type {
+        std::size_t formatted; // Records handed to the sink.
+        std::size_t dropped;   // Records dropped because the calling thread's ring was full.
+    };
+
+    static constexpr inline std::size_t default_ring_capacity = std::size_t{64} << 10;
+
+    explicit async_logger(sink_type sink, std::size_t ring_capacity = default_ring_capacity)
+        : sink_(std::move(sink)), ring_capacity_(ring_capacity), thread_([this] { run(); }) {}
+    async_logger(const async_logger &other) = delete;
+    async_logger(async_logger &&other) = delete;
+    auto operator=(const async_logger &rhs) -> async_logger & = delete;
+    auto operator=(async_logger &&rhs) -> async_logger & = delete;
+    // Formats all pending records before returning.
+    ~async_logger() {
+        {
+            auto lock = std::lock_guard(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // Captures a record for the background thread. Returns false if it was dropped because the ring was full.
+    template <class... Args>
+    auto log(log_level level, const char *format, Args &&...args) -> bool {
+        static_assert(sizeof...(Args) <= detail::max_log_arguments, "too many log arguments");
+        using record = detail::log_record<sizeof...(Args)>;
+        if (ring_for_this_thread().try_emplace<record>(level, format, std::forward<Args>(args)...) == nullptr) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            // The background thread may be in a long idle wait. Waking it is only a hint, so no lock is taken here.
+            if (!wake_requested_.exchange(true, std::memory_order_relaxed)) {
+                wake_.notify_one();
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // Waits until all records logged so far, by any thread, have been handed to the sink.
+    void flush() {
+        auto lock = std::unique_lock(mutex_);
+        wake_requested_.store(true, std::memory_order_relaxed);
+        wake_.notify_one();
+        flushed_.wait(lock, [&] { return all_rings_empty(); });
+    }
+
+    [[nodiscard]] auto stats() const -> stats_type {
+        return {formatted_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    // Each thread caches the rings it owns, keyed by a logger id that is never reused, so that a new logger at the
+    // address of a destroyed one does not pick up a stale entry. Entries of destroyed loggers are pruned whenever the
+    // thread gets a new ring, so the cache does not grow with the number of loggers a thread has ever used.
+    auto ring_for_this_thread() -> any_ring & {
+        struct cached_ring {
+            std::uint64_t id;
+            any_ring *ring;
+            std::weak_ptr<any_ring> owner;
+        };
+        thread_local std::vector<cached_ring> rings;
+        for (const auto &entry : rings) {
+            if (entry.id == id_) {
+                return *entry.ring;
+            }
+        }
+        rings.erase(std::remove_if(rings.begin(), rings.end(), [](const auto &entry) { return entry.owner.expired(); }),
+                    rings.end());
+        auto lock = std::lock_guard(mutex_);
+        const auto &ring = rings_.emplace_back(std::make_shared<any_ring>(ring_capacity_));
+        rings.push_back(cached_ring{id_, ring.get(), ring});
+        return *ring;
+    }
+
+    auto all_rings_empty() const -> bool {
+        for (const auto &ring : rings_) {
+            if (!ring->empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <std::size_t... Ns>
+    void format_record(any_ref ref, std::index_sequence<Ns...> /*unused*/) {
+        buffer_.clear();
+        auto format = [&](auto *record) {
+            if (record != nullptr) {
+                record->format_to(buffer_);
+                sink_(log_message{record->level, record->time, buffer_});
+            }
+            return record != nullptr;
+        };
+        (format(any_cast<detail::log_record<Ns>>(&ref)) || ...);
+    }
+
+    // Drains all rings, returns the number of records formatted.
+    auto drain(std::vector<any_ring *> &rings) -> std::size_t {
+        {
+            auto lock = std::lock_guard(mutex_);
+            if (rings.size() != rings_.size()) {
+                rings.clear();
+                for (const auto &ring : rings_) {
+                    rings.push_back(ring.get());
+                }
+            }
+        }
+        auto n = std::size_t{0};
+        // The count is updated before try_consume() frees the record, so that stats() is up to date once flush() has
+        // seen the rings empty.
+        for (auto *ring : rings) {
+            while (ring->try_consume([&](any_ref ref) {
+                format_record(ref, std::make_index_sequence<detail::max_log_arguments + 1>());
+                formatted_.fetch_add(1, std::memory_order_relaxed);
+            })) {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    // Polls the rings, since producers do not signal new records to keep log() cheap. The wait between polls doubles
+    // while the rings stay empty, so that an idle logger wakes up rarely, and drops back as soon as records arrive.
+    void run() {
+        auto rings = std::vector<any_ring *>();
+        auto poll_interval = min_poll_interval;
+        while (true) {
+            auto n = drain(rings);
+            auto lock = std::unique_lock(mutex_);
+            flushed_.notify_all();
+            if (stopping_) {
+                lock.unlock();
+                drain(rings);
+                return;
+            }
+            if (n != 0) {
+                poll_interval = min_poll_interval;
+                continue;
+            }
+            wake_.wait_for(lock, poll_interval,
+                           [&] { return stopping_ || wake_requested_.load(std::memory_order_relaxed); });
+            if (wake_requested_.exchange(false, std::memory_order_relaxed)) {
+                poll_interval = min_poll_interval;
+            } else {
+                poll_interval = std::min(poll_interval * 2, max_poll_interval);
+            }
+        }
+    }
+
+    static constexpr inline auto min_poll_interval = std::chrono::milliseconds(1);
+    static constexpr inline auto max_poll_interval = std::chrono::milliseconds(32);
+    static inline std::atomic<std::uint64_t> next_id_{0};
+
+    sink_type sink_;
+    std::size_t ring_capacity_;
+    const std::uint64_t id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+    std::string buffer_; // Only used by the background thread
+    std::atomic<std::size_t> formatted_{0};
+    std::atomic<std::size_t> dropped_{0};
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<std::shared_ptr<any_ring>> rings_;
+    std::atomic<bool> wake_requested_{false}; // Set by flush() and by log() when it drops a record
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+} // namespace mcpp
@@ -0,0 +1,80 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <atomic>
+#include <utility>
+
+namespace mcpp {
+
+// A slot holding a unique_any that can be replaced atomically from multiple threads without a mutex.
+//
+// Non-empty payloads are kept in a heap-allocated box (vtable header plus storage) behind an atomic pointer, so
+// exchanging whole payloads is a single pointer exchange. The empty state is a null pointer and never allocates.
+//
+// There is no load(): the slot only ever hands out payloads by moving them out. For concurrent readers of a shared
+// payload, see rcu_any.
+class atomic_unique_any {
+  public:
+    constexpr atomic_unique_any() noexcept : box_(nullptr) {}
+    explicit atomic_unique_any(unique_any desired) : box_(box(std::move(desired))) {}
+    atomic_unique_any(const atomic_unique_any &other) = delete;
+    atomic_unique_any(atomic_unique_any &&other) = delete;
+    auto operator=(const atomic_unique_any &rhs) -> atomic_unique_any & = delete;
+    auto operator=(atomic_unique_any &&rhs) -> atomic_unique_any & = delete;
+    ~atomic_unique_any() { delete box_.load(std::memory_order_acquire); }
+
+    static constexpr bool is_always_lock_free = std::atomic<unique_any *>::is_always_lock_free;
+    [[nodiscard]] auto is_lock_free() const noexcept -> bool { return box_.is_lock_free(); }
+
+    // Replaces the payload. The previous payload is destroyed on the calling thread.
+    void store(unique_any desired) { exchange(std::move(desired)); }
+
+    // Replaces the payload and returns the previous one.
+    auto exchange(unique_any desired) -> unique_any {
+        return unbox(box_.exchange(box(std::move(desired)), std::memory_order_acq_rel));
+    }
+
+    // Empties the slot and returns the previous payload.
+    auto take() noexcept -> unique_any { return unbox(box_.exchange(nullptr, std::memory_order_acq_rel)); }
+
+    // Stores desired only if the slot is currently empty. On failure, desired is left untouched.
+    //
+    // This is the only compare-exchange offered: payloads are not comparable, and comparing box addresses would be
+    // subject to ABA once a box has been freed and its address reused.
+    auto try_store(unique_any &desired) -> bool {
+        if (!desired.has_value()) {
+            return !has_value();
+        }
+        auto *boxed = box(std::move(desired));
+        auto *expected = static_cast<unique_any *>(nullptr);
+        if (box_.compare_exchange_strong(expected, boxed, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            return true;
+        }
+        desired = unbox(boxed);
+        return false;
+    }
+
+    [[nodiscard]] auto has_value() const noexcept -> bool { return box_.load(std::memory_order_acquire) != nullptr; }
+
+  private:
+    static auto box(unique_any &&value) -> unique_any * {
+        return value.has_value() ? new unique_any(std::move(value)) : nullptr;
+    }
+
+    static auto unbox(unique_any *boxed) noexcept -> unique_any {
+        auto ret = unique_any();
+        if (boxed != nullptr) {
+            ret = std::move(*boxed);
+            delete boxed;
+        }
+        return ret;
+    }
+
+    std::atomic<unique_any *> box_;
+};
+
+} // namespace mcpp
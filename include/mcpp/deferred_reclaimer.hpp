@@ -0,0 +1,135 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mcpp {
+
+// Moves the destruction of payloads off the calling thread.
+//
+// Payloads handed to the reclaimer are moved into a bounded queue and destroyed by a background thread. Moving a
+// unique_any with a heap-placed payload only copies the pointer, so handing it over is O(1) and the payload itself is
+// never relocated. Inline payloads are moved, which is cheap since they are small and nothrow-movable.
+class deferred_reclaimer {
+  public:
+    // What defer_destroy() does when the queue is full.
+    enum class overflow_policy {
+        destroy_inline, // Destroy the payload on the calling thread.
+        block,          // Wait until the background thread has made room.
+    };
+
+    struct stats_type {
+        std::size_t enqueued;   // Payloads handed to the background thread.
+        std::size_t destroyed;  // Payloads destroyed by the background thread.
+        std::size_t overflowed; // Payloads destroyed inline because the queue was full.
+        std::size_t pending;    // Payloads currently waiting in the queue.
+        std::size_t high_water; // Maximum number of payloads that were waiting at the same time.
+    };
+
+    explicit deferred_reclaimer(std::size_t capacity, overflow_policy policy = overflow_policy::destroy_inline)
+        : queue_(std::max<std::size_t>(capacity, 1)), policy_(policy), thread_([this] { run(); }) {}
+    deferred_reclaimer(const deferred_reclaimer &other) = delete;
+    deferred_reclaimer(deferred_reclaimer &&other) = delete;
+    auto operator=(const deferred_reclaimer &rhs) -> deferred_reclaimer & = delete;
+    auto operator=(deferred_reclaimer &&rhs) -> deferred_reclaimer & = delete;
+    // Destroys all pending payloads before returning.
+    ~deferred_reclaimer() {
+        {
+            auto lock = std::lock_guard(mutex_);
+            stopping_ = true;
+        }
+        not_empty_.notify_one();
+        thread_.join();
+    }
+
+    // Takes ownership of value and destroys it on the background thread. Returns false if the queue was full and the
+    // payload was destroyed inline instead.
+    auto defer_destroy(unique_any &&value) -> bool {
+        if (!value.has_value()) {
+            return true;
+        }
+        auto lock = std::unique_lock(mutex_);
+        if (size_ == queue_.size()) {
+            if (policy_ == overflow_policy::destroy_inline) {
+                lock.unlock();
+                overflowed_.fetch_add(1, std::memory_order_relaxed);
+                value.reset();
+                return false;
+            }
+            not_full_.wait(lock, [&] { return size_ < queue_.size(); });
+        }
+        queue_[(head_ + size_) % queue_.size()] = std::move(value);
+        size_ += 1;
+        high_water_ = std::max(high_water_, size_);
+        enqueued_ += 1;
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Like unique_any::reset(), but the payload is destroyed on the background thread.
+    auto deferred_reset(unique_any &value) -> bool { return defer_destroy(std::move(value)); }
+
+    // Waits until all payloads enqueued so far have been destroyed.
+    void drain() {
+        auto lock = std::unique_lock(mutex_);
+        drained_.wait(lock, [&] { return destroyed_ == enqueued_; });
+    }
+
+    [[nodiscard]] auto stats() const -> stats_type {
+        auto lock = std::lock_guard(mutex_);
+        return {enqueued_, destroyed_, overflowed_.load(std::memory_order_relaxed), size_, high_water_};
+    }
+
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t { return queue_.size(); }
+
+  private:
+    void run() {
+        auto lock = std::unique_lock(mutex_);
+        while (true) {
+            not_empty_.wait(lock, [&] { return size_ != 0 || stopping_; });
+            if (size_ == 0) {
+                return;
+            }
+            auto value = std::move(queue_[head_]);
+            head_ = (head_ + 1) % queue_.size();
+            size_ -= 1;
+            lock.unlock();
+            not_full_.notify_one();
+            value.reset();
+            lock.lock();
+            destroyed_ += 1;
+            if (destroyed_ == enqueued_) {
+                drained_.notify_all();
+            }
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable drained_;
+    std::vector<unique_any> queue_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::size_t high_water_ = 0;
+    std::size_t enqueued_ = 0;
+    std::size_t destroyed_ = 0;
+    std::atomic<std::size_t> overflowed_{0};
+    bool stopping_ = false;
+    overflow_policy policy_;
+    std::thread thread_;
+};
+
+} // namespace mcpp
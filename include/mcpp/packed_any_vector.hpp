@@ -0,0 +1,214 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/any_ref.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace mcpp {
+
+namespace detail {
+struct packed_vtable_type {
+    void (*destroy)(void *); // Null for trivially destructible payloads
+    const std::type_info &typeinfo;
+    std::uint64_t key;
+};
+
+template <class T>
+struct packed_handler {
+  private:
+    static void destroy(void *p) { static_cast<T *>(p)->~T(); }
+
+  public:
+    static constexpr inline packed_vtable_type vtable = {
+        std::is_trivially_destructible_v<T> ? nullptr : &destroy, typeid(T), type_key_v<T>};
+};
+
+struct packed_entry {
+    const packed_vtable_type *vtable;
+    void *payload;
+};
+} // namespace detail
+
+// Append-only sequence of heterogeneous payloads, which are placed one after the other in large chunks of memory owned
+// by the container.
+//
+// A std::vector<unique_any> allocates every heap-placed payload separately, so the payloads end up scattered across the
+// heap. Here, payloads are packed in insertion order, so iterating the container walks through memory sequentially, and
+// destroying or clearing it frees whole chunks. Payloads larger than the chunk size get a chunk of their own.
+//
+// Elements are handed out as mcpp::any_ref, which stays valid until the container is cleared or destroyed. Payloads
+// never move, so neither moving the container nor adding elements invalidates them.
+class packed_any_vector {
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = any_ref;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = any_ref;
+
+        iterator() = default;
+
+        auto operator*() const noexcept -> any_ref { return packed_any_vector::make_ref(*it_); }
+        auto operator[](difference_type n) const noexcept -> any_ref { return packed_any_vector::make_ref(it_[n]); }
+
+        auto operator++() noexcept -> iterator & {
+            ++it_;
+            return *this;
+        }
+        auto operator++(int) noexcept -> iterator { return iterator(it_++); }
+        auto operator--() noexcept -> iterator & {
+            --it_;
+            return *this;
+        }
+        auto operator--(int) noexcept -> iterator { return iterator(it_--); }
+        auto operator+=(difference_type n) noexcept -> iterator & {
+            it_ += n;
+            return *this;
+        }
+        auto operator-=(difference_type n) noexcept -> iterator & {
+            it_ -= n;
+            return *this;
+        }
+        friend auto operator+(iterator it, difference_type n) noexcept -> iterator { return it += n; }
+        friend auto operator+(difference_type n, iterator it) noexcept -> iterator { return it += n; }
+        friend auto operator-(iterator it, difference_type n) noexcept -> iterator { return it -= n; }
+        friend auto operator-(const iterator &lhs, const iterator &rhs) noexcept -> difference_type {
+            return lhs.it_ - rhs.it_;
+        }
+        friend auto operator==(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ == rhs.it_; }
+        friend auto operator!=(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ != rhs.it_; }
+        friend auto operator<(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ < rhs.it_; }
+        friend auto operator>(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ > rhs.it_; }
+        friend auto operator<=(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ <= rhs.it_; }
+        friend auto operator>=(const iterator &lhs, const iterator &rhs) noexcept -> bool { return lhs.it_ >= rhs.it_; }
+
+      private:
+        friend class packed_any_vector;
+        using base = std::vector<detail::packed_entry>::const_iterator;
+        explicit iterator(base it) noexcept : it_(it) {}
+        base it_;
+    };
+
+    static constexpr inline std::size_t default_chunk_size = std::size_t{64} << 10;
+
+    explicit packed_any_vector(std::size_t chunk_size = default_chunk_size) : chunk_size_(chunk_size) {}
+    packed_any_vector(const packed_any_vector &other) = delete;
+    packed_any_vector(packed_any_vector &&other) noexcept
+        : entries_(std::move(other.entries_)), chunks_(std::move(other.chunks_)),
+          chunk_size_(other.chunk_size_), pos_(std::exchange(other.pos_, nullptr)),
+          end_(std::exchange(other.end_, nullptr)) {}
+    auto operator=(const packed_any_vector &rhs) -> packed_any_vector & = delete;
+    auto operator=(packed_any_vector &&rhs) noexcept -> packed_any_vector & {
+        packed_any_vector(std::move(rhs)).swap(*this);
+        return *this;
+    }
+    ~packed_any_vector() { clear(); }
+
+    void swap(packed_any_vector &other) noexcept {
+        entries_.swap(other.entries_);
+        chunks_.swap(other.chunks_);
+        std::swap(chunk_size_, other.chunk_size_);
+        std::swap(pos_, other.pos_);
+        std::swap(end_, other.end_);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Modifiers
+    // Constructs a T at the end of the current chunk, or of a new one if it does not fit.
+    template <class ValueType, class... Args, class T = std::decay_t<ValueType>,
+              class = std::enable_if_t<std::is_constructible_v<T, Args...>>>
+    auto emplace_back(Args &&...args) -> T & {
+        auto *ptr = allocate(sizeof(T), alignof(T));
+        if (entries_.size() == entries_.capacity()) {
+            entries_.reserve(entries_.empty() ? 16 : 2 * entries_.size());
+        }
+        auto *ret = ::new (ptr) T(std::forward<Args>(args)...);
+        pos_ = static_cast<std::byte *>(ptr) + sizeof(T);
+        entries_.push_back({&detail::packed_handler<T>::vtable, ret}); // Never reallocates, see above
+        return *ret;
+    }
+    template <class ValueType, class T = std::decay_t<ValueType>>
+    auto push_back(ValueType &&value) -> T & {
+        return emplace_back<T>(std::forward<ValueType>(value));
+    }
+    // Reserves room for n element entries. Payload memory is allocated chunk by chunk.
+    void reserve(std::size_t n) { entries_.reserve(n); }
+    // Destroys all payloads in reverse order and frees all chunks.
+    void clear() noexcept {
+        for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+            if (it->vtable->destroy != nullptr) {
+                it->vtable->destroy(it->payload);
+            }
+        }
+        entries_.clear();
+        chunks_.clear();
+        pos_ = nullptr;
+        end_ = nullptr;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Access
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return entries_.size(); }
+    [[nodiscard]] auto empty() const noexcept -> bool { return entries_.empty(); }
+    // Number of chunks holding payloads.
+    [[nodiscard]] auto chunk_count() const noexcept -> std::size_t { return chunks_.size(); }
+    auto operator[](std::size_t i) const noexcept -> any_ref { return make_ref(entries_[i]); }
+    [[nodiscard]] auto at(std::size_t i) const -> any_ref {
+        if (i >= entries_.size()) {
+            throw std::out_of_range("mcpp::packed_any_vector::at");
+        }
+        return make_ref(entries_[i]);
+    }
+    [[nodiscard]] auto begin() const noexcept -> iterator { return iterator(entries_.begin()); }
+    [[nodiscard]] auto end() const noexcept -> iterator { return iterator(entries_.end()); }
+
+  private:
+    static auto make_ref(const detail::packed_entry &entry) noexcept -> any_ref {
+        return any_ref(entry.vtable->typeinfo, entry.vtable->key, entry.payload);
+    }
+
+    // Returns suitably aligned memory for size bytes, but only advances the fill position after construction succeeded.
+    auto allocate(std::size_t size, std::size_t alignment) -> void * {
+        if (auto *ptr = align(pos_, end_, size, alignment)) {
+            return ptr;
+        }
+        auto chunk_size = std::max(chunk_size_, size + alignment - 1);
+        // Not make_unique, which would zero the whole chunk before it is used.
+        chunks_.push_back(std::unique_ptr<std::byte[]>(new std::byte[chunk_size]));
+        pos_ = chunks_.back().get();
+        end_ = pos_ + chunk_size;
+        return align(pos_, end_, size, alignment);
+    }
+
+    static auto align(std::byte *pos, std::byte *end, std::size_t size, std::size_t alignment) noexcept -> void * {
+        if (pos == nullptr) {
+            return nullptr;
+        }
+        auto space = static_cast<std::size_t>(end - pos);
+        auto *ptr = static_cast<void *>(pos);
+        return std::align(alignment, size, ptr, space);
+    }
+
+    std::vector<detail::packed_entry> entries_;
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    std::size_t chunk_size_;
+    std::byte *pos_ = nullptr;
+    std::byte *end_ = nullptr;
+};
+
+} // namespace mcpp
@@ -0,0 +1,99 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+namespace mcpp {
+
+// Iterator adaptor that calls prefetch() on the element `distance` positions ahead of the new position whenever it is
+// incremented. Together with prefetch_range, which prefetches the first distance + 1 elements, every element is
+// prefetched exactly once.
+//
+// Meant for iterating containers of unique_any (or anything else with a prefetch() member), where each heap-placed
+// payload is otherwise a cache miss. The underlying iterator must be random access.
+template <class Iterator>
+class prefetch_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    using pointer = typename std::iterator_traits<Iterator>::pointer;
+    using reference = typename std::iterator_traits<Iterator>::reference;
+
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                    typename std::iterator_traits<Iterator>::iterator_category>);
+
+    prefetch_iterator() = default;
+    prefetch_iterator(Iterator it, Iterator end, difference_type distance) : it_(it), end_(end), distance_(distance) {}
+
+    auto operator*() const -> reference { return *it_; }
+    auto operator->() const -> Iterator { return it_; }
+
+    auto operator++() -> prefetch_iterator & {
+        ++it_;
+        if (end_ - it_ > distance_) {
+            it_[distance_].prefetch();
+        }
+        return *this;
+    }
+    auto operator++(int) -> prefetch_iterator {
+        auto ret = *this;
+        ++*this;
+        return ret;
+    }
+
+    [[nodiscard]] auto base() const -> Iterator { return it_; }
+
+    friend auto operator==(const prefetch_iterator &lhs, const prefetch_iterator &rhs) -> bool {
+        return lhs.it_ == rhs.it_;
+    }
+    friend auto operator!=(const prefetch_iterator &lhs, const prefetch_iterator &rhs) -> bool {
+        return lhs.it_ != rhs.it_;
+    }
+
+  private:
+    Iterator it_{};
+    Iterator end_{};
+    difference_type distance_ = 0;
+};
+
+template <class Iterator>
+class prefetch_range {
+  public:
+    using iterator = prefetch_iterator<Iterator>;
+    using difference_type = typename iterator::difference_type;
+
+    prefetch_range(Iterator first, Iterator last, difference_type distance)
+        : first_(first, last, distance), last_(last, last, distance) {
+        // Warm up the window up to and including the element that the first increment does not reach.
+        for (auto it = first; it != last && it - first <= distance; ++it) {
+            it->prefetch();
+        }
+    }
+
+    [[nodiscard]] auto begin() const -> iterator { return first_; }
+    [[nodiscard]] auto end() const -> iterator { return last_; }
+
+  private:
+    iterator first_;
+    iterator last_;
+};
+
+// Iterates over range while prefetching the payloads of the elements `distance` positions ahead.
+//
+// The best distance depends on the per-element work: enough elements to cover a memory round trip. 8 to 16 is a
+// reasonable start for light loops.
+template <class Range>
+auto prefetch_ahead(Range &range, std::ptrdiff_t distance = 8) {
+    using std::begin;
+    using std::end;
+    using iterator = decltype(begin(range));
+    return prefetch_range<iterator>(begin(range), end(range), distance);
+}
+
+} // namespace mcpp
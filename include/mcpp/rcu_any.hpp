@@ -0,0 +1,163 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mcpp {
+
+namespace detail {
+struct rcu_reader_slot {
+    static constexpr inline std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+    std::atomic<std::uint64_t> epoch{idle};
+};
+} // namespace detail
+
+// A read-mostly published unique_any with epoch-based reclamation.
+//
+// Readers take wait-free snapshots of the current payload: a snapshot costs one store to the reader's own epoch slot
+// and two loads, and touches no shared reference count. Writers publish a new payload and retire the old one, which
+// is destroyed once every reader that might still observe it has released its snapshot.
+//
+// Each reading thread registers a reader once and reuses it for all its snapshots. A reader holds at most one
+// snapshot at a time. Readers must not outlive the rcu_any they were created from.
+class rcu_any {
+  public:
+    class reader;
+
+    // A reader's view of the payload that was current when the snapshot was taken.
+    class snapshot {
+      public:
+        snapshot(const snapshot &other) = delete;
+        auto operator=(const snapshot &rhs) -> snapshot & = delete;
+        snapshot(snapshot &&other) noexcept
+            : slot_(std::exchange(other.slot_, nullptr)), value_(std::exchange(other.value_, nullptr)) {}
+        auto operator=(snapshot &&rhs) -> snapshot & = delete;
+        ~snapshot() {
+            if (slot_ != nullptr) {
+                slot_->epoch.store(detail::rcu_reader_slot::idle, std::memory_order_release);
+            }
+        }
+
+        [[nodiscard]] auto get() const noexcept -> const unique_any & { return value_ != nullptr ? *value_ : empty_; }
+        auto operator*() const noexcept -> const unique_any & { return get(); }
+        auto operator->() const noexcept -> const unique_any * { return &get(); }
+
+      private:
+        friend class reader;
+        snapshot(detail::rcu_reader_slot *slot, const unique_any *value) noexcept : slot_(slot), value_(value) {}
+
+        static inline const unique_any empty_{};
+
+        detail::rcu_reader_slot *slot_;
+        const unique_any *value_;
+    };
+
+    class reader {
+      public:
+        reader(const reader &other) = delete;
+        auto operator=(const reader &rhs) -> reader & = delete;
+        reader(reader &&other) noexcept
+            : owner_(std::exchange(other.owner_, nullptr)), slot_(std::exchange(other.slot_, nullptr)) {}
+        auto operator=(reader &&rhs) -> reader & = delete;
+        ~reader() {
+            if (owner_ != nullptr) {
+                owner_->unregister_reader(slot_);
+            }
+        }
+
+        // Wait-free.
+        [[nodiscard]] auto read() noexcept -> snapshot {
+            assert(slot_->epoch.load(std::memory_order_relaxed) == detail::rcu_reader_slot::idle);
+            slot_->epoch.store(owner_->epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+            return {slot_, owner_->current_.load(std::memory_order_seq_cst)};
+        }
+
+      private:
+        friend class rcu_any;
+        reader(rcu_any *owner, detail::rcu_reader_slot *slot) noexcept : owner_(owner), slot_(slot) {}
+
+        rcu_any *owner_;
+        detail::rcu_reader_slot *slot_;
+    };
+
+    rcu_any() = default;
+    explicit rcu_any(unique_any value) : current_(new unique_any(std::move(value))) {}
+    rcu_any(const rcu_any &other) = delete;
+    rcu_any(rcu_any &&other) = delete;
+    auto operator=(const rcu_any &rhs) -> rcu_any & = delete;
+    auto operator=(rcu_any &&rhs) -> rcu_any & = delete;
+    ~rcu_any() {
+        assert(readers_.empty());
+        delete current_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] auto make_reader() -> reader {
+        auto lock = std::lock_guard(mutex_);
+        readers_.push_back(std::make_unique<detail::rcu_reader_slot>());
+        return {this, readers_.back().get()};
+    }
+
+    // Publishes a new payload. The previous payload is retired and destroyed by this or a later call to publish() or
+    // collect() once no snapshot can refer to it anymore.
+    void publish(unique_any value) {
+        auto next = std::make_unique<unique_any>(std::move(value));
+        auto lock = std::lock_guard(mutex_);
+        retired_.reserve(retired_.size() + 1);
+        auto prev = std::unique_ptr<unique_any>(current_.exchange(next.release(), std::memory_order_seq_cst));
+        auto epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (prev != nullptr) {
+            retired_.push_back({epoch, std::move(prev)});
+        }
+        reclaim();
+    }
+
+    // Destroys retired payloads that are no longer observable and returns the number still waiting for readers.
+    auto collect() -> std::size_t {
+        auto lock = std::lock_guard(mutex_);
+        reclaim();
+        return retired_.size();
+    }
+
+  private:
+    struct retired {
+        std::uint64_t epoch;
+        std::unique_ptr<unique_any> value;
+    };
+
+    void reclaim() {
+        auto min_epoch = detail::rcu_reader_slot::idle;
+        for (const auto &slot : readers_) {
+            min_epoch = std::min(min_epoch, slot->epoch.load(std::memory_order_seq_cst));
+        }
+        // A reader that can still see a payload retired at epoch e has announced an epoch <= e.
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                      [&](const retired &r) { return r.epoch < min_epoch; }),
+                       retired_.end());
+    }
+
+    void unregister_reader(detail::rcu_reader_slot *slot) noexcept {
+        auto lock = std::lock_guard(mutex_);
+        auto it = std::find_if(readers_.begin(), readers_.end(), [&](const auto &r) { return r.get() == slot; });
+        readers_.erase(it);
+    }
+
+    std::atomic<unique_any *> current_{nullptr};
+    std::atomic<std::uint64_t> epoch_{0};
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<detail::rcu_reader_slot>> readers_;
+    std::vector<retired> retired_;
+};
+
+} // namespace mcpp
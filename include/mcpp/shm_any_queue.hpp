@@ -0,0 +1,319 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/any_ref.hpp"
+#include "mcpp/type_key.hpp"
+#include "mcpp/unique_any.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mcpp {
+
+namespace detail {
+// Start of the shared memory segment, followed by the buffer. Positions are monotonic byte counters, as in any_ring.
+struct shm_queue_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t capacity;
+    alignas(64) std::atomic<std::uint64_t> tail; // End of the space reserved by producers
+    alignas(64) std::atomic<std::uint64_t> head; // End of the space released by the consumer
+};
+
+constexpr inline char shm_queue_magic[8] = {'m', 'c', 'p', 'p', 's', 'h', 'm', 'q'};
+constexpr inline std::uint32_t shm_queue_version = 1;
+constexpr inline std::uint32_t shm_queue_byte_order = 0x01020304;
+constexpr inline std::size_t shm_queue_buffer_offset = 192;
+static_assert(sizeof(shm_queue_header) <= shm_queue_buffer_offset);
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free,
+              "shared memory queues need address-free atomics");
+
+// Every record starts at a multiple of 16 bytes with this header. The state is 0 while the record is not yet
+// committed, shm_record_padding for padding up to the end of the buffer, and otherwise the offset of the payload from
+// the start of the record. Unused buffer space is all zeros, so a record that is being written reads as uncommitted.
+struct shm_record {
+    std::atomic<std::uint32_t> state;
+    std::uint32_t size; // Size of the whole record including header and padding
+    std::uint64_t key;
+};
+
+constexpr inline std::uint32_t shm_record_padding = 1;
+constexpr inline std::size_t shm_record_alignment = 16;
+constexpr inline std::size_t shm_buffer_alignment = 64;
+static_assert(sizeof(shm_record) == shm_record_alignment);
+
+constexpr auto shm_align_up(std::size_t n, std::size_t alignment) -> std::size_t {
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+// What the consumer knows about an accepted payload type.
+struct shm_accepted_type {
+    const std::type_info *typeinfo;
+    std::size_t size;
+    void (*rebuild)(const void *, unique_any &);
+};
+
+template <class T>
+void shm_rebuild(const void *payload, unique_any &any) {
+    if constexpr (std::is_default_constructible_v<T>) {
+        std::memcpy(static_cast<void *>(&any.emplace<T>()), payload, sizeof(T));
+    } else {
+        any.emplace_from([&] {
+            alignas(T) unsigned char raw[sizeof(T)];
+            std::memcpy(raw, payload, sizeof(T));
+            return *std::launder(reinterpret_cast<const T *>(raw));
+        });
+    }
+}
+} // namespace detail
+
+// Queue of trivially copyable payloads in a POSIX shared memory segment, for exchanging typed messages between
+// processes without serialization.
+//
+// Records are laid out as in any_ring, but carry the type key of their payload instead of a vtable pointer, which
+// would be meaningless in another process. The consumer declares the payload types it understands with accept<T>()
+// and gets them back as any_ref views into the segment or as rebuilt unique_any objects. Type keys are only stable
+// between builds made with the same compiler.
+//
+// Any number of producers, in any processes, may call try_push concurrently; they reserve space with a CAS and commit
+// their records independently. Only one consumer may call try_consume or try_pop at a time. Payload alignment is
+// limited to 64 bytes.
+class shm_any_queue {
+  public:
+    // Creates a new segment with the given name, which must not exist yet. Portable names start with a slash and are at
+    // most 31 characters long, the limit on macOS. The capacity is rounded up to a multiple of 16 bytes.
+    static auto create(const std::string &name, std::size_t capacity) -> shm_any_queue {
+        capacity = detail::shm_align_up(capacity, detail::shm_record_alignment);
+        auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("mcpp::shm_any_queue: cannot create " + name);
+        }
+        auto size = detail::shm_queue_buffer_offset + capacity;
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("mcpp::shm_any_queue: cannot resize " + name);
+        }
+        auto queue = shm_any_queue(map(fd, size, name), size);
+        auto *header = ::new (static_cast<void *>(queue.header_)) detail::shm_queue_header{
+            {}, detail::shm_queue_version, detail::shm_queue_byte_order, capacity, {0}, {0}};
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, detail::shm_queue_magic, sizeof(header->magic));
+        return queue;
+    }
+
+    // Opens an existing segment created by create().
+    static auto open(const std::string &name) -> shm_any_queue {
+        auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error("mcpp::shm_any_queue: cannot open " + name);
+        }
+        struct ::stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < detail::shm_queue_buffer_offset) {
+            ::close(fd);
+            throw std::runtime_error("mcpp::shm_any_queue: not a queue: " + name);
+        }
+        auto size = static_cast<std::size_t>(st.st_size);
+        auto queue = shm_any_queue(map(fd, size, name), size);
+        const auto *header = queue.header_;
+        if (std::memcmp(header->magic, detail::shm_queue_magic, sizeof(header->magic)) != 0 ||
+            header->version != detail::shm_queue_version || header->byte_order != detail::shm_queue_byte_order ||
+            header->capacity != size - detail::shm_queue_buffer_offset) {
+            throw std::runtime_error("mcpp::shm_any_queue: not a compatible queue: " + name);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return queue;
+    }
+
+    // Removes the name of a segment. Processes that have it open keep using it.
+    static void remove(const std::string &name) noexcept { ::shm_unlink(name.c_str()); }
+
+    shm_any_queue(const shm_any_queue &other) = delete;
+    shm_any_queue(shm_any_queue &&other) noexcept
+        : header_(std::exchange(other.header_, nullptr)), size_(std::exchange(other.size_, 0)),
+          accepted_(std::move(other.accepted_)) {}
+    auto operator=(const shm_any_queue &rhs) -> shm_any_queue & = delete;
+    auto operator=(shm_any_queue &&rhs) noexcept -> shm_any_queue & {
+        shm_any_queue(std::move(rhs)).swap(*this);
+        return *this;
+    }
+    ~shm_any_queue() {
+        if (header_ != nullptr) {
+            ::munmap(header_, size_);
+        }
+    }
+
+    void swap(shm_any_queue &other) noexcept {
+        std::swap(header_, other.header_);
+        std::swap(size_, other.size_);
+        accepted_.swap(other.accepted_);
+    }
+
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t {
+        return static_cast<std::size_t>(header_->capacity);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Producer
+    // Copies value to the end of the queue. Returns false if there is not enough space.
+    template <class T>
+    auto try_push(const T &value) -> bool {
+        static_assert(std::is_trivially_copyable_v<T>, "shared memory queues only hold trivially copyable payloads");
+        static_assert(has_unique_type_key_v<T>, "T must have a unique type key, see mcpp::has_unique_type_key_v");
+        static_assert(alignof(T) <= detail::shm_buffer_alignment);
+        auto capacity = this->capacity();
+        auto tail = header_->tail.load(std::memory_order_relaxed);
+        auto pos = std::size_t{0};
+        auto payload_offset = std::size_t{0};
+        auto size = std::size_t{0};
+        auto skip = std::size_t{0};
+        do {
+            pos = tail % capacity;
+            payload_offset = payload_offset_at<T>(pos);
+            size = detail::shm_align_up(payload_offset + sizeof(T), detail::shm_record_alignment);
+            skip = 0;
+            if (capacity - pos < size) {
+                // Does not fit before the end of the buffer, pad and start over at the beginning.
+                skip = capacity - pos;
+                payload_offset = payload_offset_at<T>(0);
+                size = detail::shm_align_up(payload_offset + sizeof(T), detail::shm_record_alignment);
+            }
+            if (size > capacity || tail + skip + size - header_->head.load(std::memory_order_acquire) > capacity) {
+                return false;
+            }
+        } while (!header_->tail.compare_exchange_weak(tail, tail + skip + size, std::memory_order_relaxed));
+        if (skip != 0) {
+            auto *padding = record_at(pos);
+            padding->size = static_cast<std::uint32_t>(skip);
+            padding->state.store(detail::shm_record_padding, std::memory_order_release);
+            pos = 0;
+        }
+        auto *record = record_at(pos);
+        std::memcpy(reinterpret_cast<std::byte *>(record) + payload_offset, &value, sizeof(T));
+        record->size = static_cast<std::uint32_t>(size);
+        record->key = type_key_v<T>;
+        record->state.store(static_cast<std::uint32_t>(payload_offset), std::memory_order_release);
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Consumer
+    // Declares that this consumer understands payloads of type T. Producers in other processes must use the same
+    // definition of T.
+    template <class T>
+    void accept() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        static_assert(has_unique_type_key_v<T>, "T must have a unique type key, see mcpp::has_unique_type_key_v");
+        accepted_[type_key_v<T>] = {&typeid(T), sizeof(T), detail::shm_rebuild<T>};
+    }
+
+    // Calls f with a reference to the oldest payload in the segment, then releases it. Returns false if the queue is
+    // empty or its oldest record is not committed yet. Throws std::logic_error, after releasing the record, if its type
+    // was not accepted.
+    template <class F>
+    auto try_consume(F &&f) -> bool {
+        return consume([&](const detail::shm_accepted_type &type, std::uint64_t key, void *payload) {
+            std::forward<F>(f)(any_ref(*type.typeinfo, key, payload));
+        });
+    }
+
+    // Like try_consume, but copies the oldest payload into a unique_any.
+    auto try_pop() -> std::optional<unique_any> {
+        auto ret = std::optional<unique_any>();
+        consume([&](const detail::shm_accepted_type &type, std::uint64_t /*key*/, void *payload) {
+            type.rebuild(payload, ret.emplace());
+        });
+        return ret;
+    }
+
+    [[nodiscard]] auto empty() const noexcept -> bool {
+        return header_->head.load(std::memory_order_acquire) == header_->tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    shm_any_queue(void *mapping, std::size_t size) noexcept
+        : header_(static_cast<detail::shm_queue_header *>(mapping)), size_(size) {}
+
+    static auto map(int fd, std::size_t size, const std::string &name) -> void * {
+        auto *ret = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (ret == MAP_FAILED) {
+            throw std::runtime_error("mcpp::shm_any_queue: cannot map " + name);
+        }
+        return ret;
+    }
+
+    template <class T>
+    static auto payload_offset_at(std::size_t pos) noexcept -> std::size_t {
+        return detail::shm_align_up(pos + sizeof(detail::shm_record), alignof(T)) - pos;
+    }
+
+    auto buffer() const noexcept -> std::byte * {
+        return reinterpret_cast<std::byte *>(header_) + detail::shm_queue_buffer_offset;
+    }
+
+    auto record_at(std::size_t pos) const noexcept -> detail::shm_record * {
+        return std::launder(reinterpret_cast<detail::shm_record *>(buffer() + pos));
+    }
+
+    // Zeroes the record, so that a record written there later reads as uncommitted, and hands its space back to the
+    // producers.
+    void release(detail::shm_record *record, std::uint64_t next) noexcept {
+        std::memset(static_cast<void *>(record), 0, record->size);
+        header_->head.store(next, std::memory_order_release);
+    }
+
+    template <class F>
+    auto consume(F &&f) -> bool {
+        auto capacity = this->capacity();
+        auto head = header_->head.load(std::memory_order_relaxed);
+        auto *record = record_at(head % capacity);
+        auto state = record->state.load(std::memory_order_acquire);
+        if (state == detail::shm_record_padding) {
+            head += record->size;
+            release(record, head);
+            record = record_at(head % capacity);
+            state = record->state.load(std::memory_order_acquire);
+        }
+        if (state == 0) {
+            return false;
+        }
+        auto *payload = reinterpret_cast<std::byte *>(record) + state;
+        struct guard {
+            shm_any_queue &queue;
+            detail::shm_record *record;
+            std::uint64_t next;
+            ~guard() { queue.release(record, next); }
+        } g{*this, record, head + record->size};
+        auto it = accepted_.find(record->key);
+        if (it == accepted_.end() || it->second.size > record->size - state) {
+            throw std::logic_error("mcpp::shm_any_queue: payload type was not accepted");
+        }
+        std::forward<F>(f)(it->second, record->key, payload);
+        return true;
+    }
+
+    detail::shm_queue_header *header_;
+    std::size_t size_;
+    std::unordered_map<std::uint64_t, detail::shm_accepted_type> accepted_;
+};
+
+} // namespace mcpp
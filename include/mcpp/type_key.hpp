@@ -0,0 +1,85 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <typeinfo>
+
+namespace mcpp {
+
+namespace detail {
+template <class T>
+constexpr auto type_signature() noexcept -> std::string_view {
+#if defined(__clang__) || defined(__GNUC__)
+    return __PRETTY_FUNCTION__;
+#elif defined(_MSC_VER)
+    return __FUNCSIG__;
+#else
+#error "mcpp::type_key requires __PRETTY_FUNCTION__ or __FUNCSIG__"
+#endif
+}
+
+constexpr auto fnv1a(std::string_view str) noexcept -> std::uint64_t {
+    auto ret = std::uint64_t{14695981039346656037U};
+    for (auto c : str) {
+        ret ^= static_cast<unsigned char>(c);
+        ret *= std::uint64_t{1099511628211U};
+    }
+    return ret;
+}
+
+// Pretty-printed names are unique for types with a name that is visible to the linker, but not for lambdas, unnamed
+// types, local classes and types in anonymous namespaces: two lambdas in the same function, or types in anonymous
+// namespaces of different translation units, can have the same name. These are the markers that GCC, Clang and MSVC
+// print for them, anywhere in the name, so that also templates instantiated with such types are detected.
+constexpr inline std::string_view ambiguous_name_markers[] = {
+    "<lambda(", "<lambda_", "(lambda at ", "{lambda(", "{anonymous}", "(anonymous ",
+    "`anonymous ", "<anonymous ", "<unnamed", "(unnamed ", ")::", "'::"};
+
+template <class T>
+constexpr auto has_unique_name() noexcept -> bool {
+    constexpr auto name = type_signature<T>();
+    for (auto marker : ambiguous_name_markers) {
+        if (name.find(marker) != std::string_view::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace detail
+
+// Whether type_key_v<T> identifies T on its own. False for lambdas, unnamed types, local classes and types in anonymous
+// namespaces, and for everything that is named after them, such as std::vector of a lambda.
+template <class T>
+inline constexpr bool has_unique_type_key_v = detail::has_unique_name<T>();
+
+// Stable 64-bit key for a type, computed at compile time from its pretty-printed name.
+//
+// Unlike std::type_info, the key is the same in every shared object built with the same compiler, regardless of
+// symbol visibility or dlopen flags, and comparing two keys is a single integer comparison. Types are identified by
+// their key alone if has_unique_type_key_v is true, which is recorded in the lowest bit of the key. Other types are
+// additionally compared by the address of their std::type_info object, so they can only be told apart, and cast, within
+// the shared object that created them (or across shared objects that share symbols). Functions that pass keys to other
+// processes or store them, such as serialization, reject these types at compile time.
+template <class T>
+inline constexpr std::uint64_t type_key_v =
+    (detail::fnv1a(detail::type_signature<T>()) & ~std::uint64_t{1}) | (has_unique_type_key_v<T> ? 0 : 1);
+
+namespace detail {
+constexpr auto is_unique_type_key(std::uint64_t key) noexcept -> bool { return (key & 1) == 0; }
+
+// Whether a payload with the given key and type_info object is a T.
+template <class T>
+auto is_type(std::uint64_t key, const std::type_info &type) noexcept -> bool {
+    if constexpr (has_unique_type_key_v<T>) {
+        return key == type_key_v<T>;
+    } else {
+        return &type == &typeid(T);
+    }
+}
+} // namespace detail
+
+} // namespace mcpp
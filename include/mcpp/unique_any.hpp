@@ -4,44 +4,278 @@
 
 #pragma once
 
+#include "mcpp/type_key.hpp"
 #include <any>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <typeinfo>
 #include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace mcpp {
 
+// Tag for constructing a payload from the result of a factory function, see unique_any(from_factory_t, F &&).
+struct from_factory_t {
+    explicit from_factory_t() = default;
+};
+inline constexpr from_factory_t from_factory{};
+
+// Customization point: specialize as std::true_type for types that can be moved by copying their bytes and then
+// forgetting the source object, such as most pointer wrappers. Such payloads are moved with a plain memcpy.
+template <class T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template <class T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+// Customization point: specialize for heap-placed payload types that are expensive to construct but cheap to reset.
+// Destroyed payloads of such a type are reset and kept, still constructed, in a thread-local pool, and emplace()
+// without arguments takes them from there instead of allocating and constructing a new one. The specialization needs
+//   static constexpr std::size_t capacity; // Maximum number of pooled payloads per thread
+//   static void reset(T &value) noexcept;  // Brings value back to its default state, ideally keeping its capacity
+template <class T>
+struct pool_traits {};
+
+// Size from which payload types are treated as huge by default, see is_huge_payload.
+inline constexpr std::size_t huge_payload_threshold = std::size_t{1} << 20;
+
+// Customization point: whether heap-placed payloads of type T get their own memory mapping (backed by transparent huge
+// pages where possible) and are returned to the OS when destroyed, instead of going through the allocator. True for
+// types of at least huge_payload_threshold bytes by default. Only supported on Linux, ignored elsewhere.
+//
+// The choice is part of the payload type's vtable, so it must be the same in every translation unit, which is why it
+// is a trait and not a configuration macro.
+template <class T>
+struct is_huge_payload : std::bool_constant<sizeof(T) >= huge_payload_threshold> {};
+
 namespace detail {
-constexpr inline std::size_t small_buffer_size = 3 * sizeof(void *);
-constexpr inline std::size_t small_buffer_alignment = std::alignment_of_v<void *>;
-using small_buffer = std::aligned_storage_t<small_buffer_size, small_buffer_alignment>;
+template <class T>
+struct is_basic_string : std::false_type {};
+template <class CharT, class Traits, class Allocator>
+struct is_basic_string<std::basic_string<CharT, Traits, Allocator>> : std::true_type {};
+} // namespace detail
 
-template <typename T>
-constexpr inline bool is_small_object_v = sizeof(T) <= sizeof(small_buffer) &&                               //
-                                          std::alignment_of_v<small_buffer> % std::alignment_of_v<T> == 0 && //
-                                          std::is_nothrow_move_constructible_v<T>;
+// Customization point: whether payloads of type T are compared with operator== when comparing unique_any objects, and
+// hashed with std::hash<T> by hash(). True for arithmetic, enumeration and pointer types and std::basic_string; other
+// types opt in by specializing it as std::true_type. It is not detected, since the comparison is instantiated for every
+// stored payload type, and many types declare an operator== that does not compile for all of them, such as containers
+// and std::variant.
+template <class T>
+struct is_equality_comparable
+    : std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T> ||
+                         detail::is_basic_string<T>::value> {};
+template <class T>
+inline constexpr bool is_equality_comparable_v = is_equality_comparable<T>::value;
 
-union storage {
-    constexpr storage() : ptr(nullptr) {}
-    void *ptr;
-    small_buffer buf;
-};
+// Customization point: whether payloads of type T are ordered with operator< by three_way_compare() and sort_any().
+// True for arithmetic and enumeration types and std::basic_string; other types opt in by specializing it as
+// std::true_type. Not detected, for the same reason as is_equality_comparable.
+template <class T>
+struct is_less_than_comparable
+    : std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T> || detail::is_basic_string<T>::value> {};
+template <class T>
+inline constexpr bool is_less_than_comparable_v = is_less_than_comparable<T>::value;
+
+template <class T>
+struct is_cloneable;
+
+namespace detail {
+template <class T, class = void>
+struct has_value_type : std::false_type {};
+template <class T>
+struct has_value_type<T, std::void_t<typename T::value_type>> : std::true_type {};
+
+template <class T, class = void>
+struct is_tuple_like : std::false_type {};
+template <class T>
+struct is_tuple_like<T, std::void_t<decltype(std::tuple_size<T>::value)>> : std::true_type {};
+
+template <class T, std::size_t... Is>
+constexpr auto tuple_elements_cloneable(std::index_sequence<Is...> /*unused*/) -> bool {
+    return (is_cloneable<std::remove_cv_t<std::tuple_element_t<Is, T>>>::value && ...);
+}
+
+// std::is_copy_constructible is true for containers, std::pair and std::tuple even if their elements are move-only, so
+// the elements are checked as well: the value_type of containers and std::optional, and the elements of tuple-like
+// types.
+template <class T>
+constexpr auto is_copy_constructible_deep() -> bool {
+    if constexpr (!std::is_copy_constructible_v<T>) {
+        return false;
+    } else if constexpr (has_value_type<T>::value) {
+        using value_type = std::remove_cv_t<typename T::value_type>;
+        if constexpr (std::is_same_v<value_type, T>) {
+            return true;
+        } else {
+            return is_cloneable<value_type>::value;
+        }
+    } else if constexpr (is_tuple_like<T>::value) {
+        return tuple_elements_cloneable<T>(std::make_index_sequence<std::tuple_size<T>::value>());
+    } else {
+        return true;
+    }
+}
+} // namespace detail
 
+// Customization point: whether payloads of type T are copied by try_clone(). True for copy constructible types, where
+// the elements of standard containers, std::optional, std::pair and std::tuple must be cloneable, too. Aggregates and
+// other classes whose copy constructor is implicitly declared but does not compile, because a member is a container of
+// move-only elements, cannot be detected and must opt out by specializing it as std::false_type. Otherwise storing them
+// fails to compile.
+template <class T>
+struct is_cloneable : std::bool_constant<detail::is_copy_constructible_deep<T>()> {};
+template <class T>
+inline constexpr bool is_cloneable_v = is_cloneable<T>::value;
+
+namespace detail {
+template <typename T, std::size_t Size, std::size_t Align>
+constexpr inline bool is_small_object_v = sizeof(T) <= Size &&                  //
+                                          Align % std::alignment_of_v<T> == 0 && //
+                                          std::is_nothrow_move_constructible_v<T>;
+
+// All operations work on the object's inline buffer. Heap-placed payloads store their pointer at its start.
 struct vtable_type {
-    void (&destroy)(storage &);
-    void (&move)(storage &, storage &);
-    void *(&get)(storage &);
+    void (&destroy)(void *);
+    void (&move)(void *, void *);
+    void *(&get)(void *);
     const std::type_info &typeinfo;
+    std::uint64_t key; // type_key_v of the payload type
+    bool is_inline;
+    bool is_trivially_relocatable; // The buffer can be moved with memcpy instead of calling move
+    // Operate on the payloads returned by get(). Null unless the payload type is hashable, is_equality_comparable or
+    // is_less_than_comparable, respectively.
+    std::size_t (*hash)(const void *);
+    bool (*equal)(const void *, const void *);
+    bool (*less)(const void *, const void *);
+    // Copy-constructs the payload of the first buffer into the second, which must not hold a payload. Null if the
+    // payload type is not cloneable.
+    void (*clone)(const void *, void *);
 };
 
+template <class T, class = void>
+constexpr inline bool has_std_hash_v = false;
+template <class T>
+constexpr inline bool has_std_hash_v<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T &>()))>> = true;
+
+// Hashing is only enabled together with equality. A std::hash that does not apply to T is disabled, which is detected
+// reliably.
+template <class T>
+constexpr inline bool is_hashable_v = is_equality_comparable_v<T> && has_std_hash_v<T>;
+template <class T>
+struct is_hashable : std::bool_constant<is_hashable_v<T>> {};
+
+template <class T>
+auto hash_payload(const void *ptr) -> std::size_t {
+    return std::hash<T>{}(*static_cast<const T *>(ptr));
+}
+
+template <class T>
+auto equal_payloads(const void *lhs, const void *rhs) -> bool {
+    return static_cast<bool>(*static_cast<const T *>(lhs) == *static_cast<const T *>(rhs));
+}
+
+template <class T>
+auto less_payloads(const void *lhs, const void *rhs) -> bool {
+    return static_cast<bool>(*static_cast<const T *>(lhs) < *static_cast<const T *>(rhs));
+}
+
+template <class T>
+constexpr auto hash_entry() noexcept -> std::size_t (*)(const void *) {
+    if constexpr (is_hashable_v<T>) {
+        return &hash_payload<T>;
+    } else {
+        return nullptr;
+    }
+}
+
+template <class T>
+constexpr auto equal_entry() noexcept -> bool (*)(const void *, const void *) {
+    if constexpr (is_equality_comparable_v<T>) {
+        return &equal_payloads<T>;
+    } else {
+        return nullptr;
+    }
+}
+
+template <class Handler, class T>
+void clone_payload(const void *src, void *dst) {
+    Handler::create(dst, *static_cast<const T *>(Handler::get(const_cast<void *>(src))));
+}
+
+template <class Handler, class T>
+constexpr auto clone_entry() noexcept -> void (*)(const void *, void *) {
+    if constexpr (is_cloneable_v<T>) {
+        return &clone_payload<Handler, T>;
+    } else {
+        return nullptr;
+    }
+}
+
+template <class T>
+constexpr auto less_entry() noexcept -> bool (*)(const void *, const void *) {
+    if constexpr (is_less_than_comparable_v<T>) {
+        return &less_payloads<T>;
+    } else {
+        return nullptr;
+    }
+}
+
+inline auto load_ptr(const void *buf) noexcept -> void * {
+    auto *ret = static_cast<void *>(nullptr);
+    std::memcpy(&ret, buf, sizeof(ret));
+    return ret;
+}
+
+inline void store_ptr(void *buf, void *ptr) noexcept { std::memcpy(buf, &ptr, sizeof(ptr)); }
+
+inline void prefetch(const void *ptr) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr);
+#else
+    static_cast<void>(ptr);
+#endif
+}
+
 template <class T>
 struct small_buffer_handler;
 template <class T>
 struct default_handler;
+template <class T>
+struct pooled_handler;
+template <class T>
+struct mapped_handler;
 
+template <class T, class = void>
+constexpr inline bool is_pooled_v = false;
 template <class T>
-using handler = std::conditional_t<is_small_object_v<T>, small_buffer_handler<T>, default_handler<T>>;
+constexpr inline bool is_pooled_v<T, std::void_t<decltype(pool_traits<T>::capacity)>> = true;
+
+#if defined(__linux__)
+template <class T>
+constexpr inline bool is_mapped_v = is_huge_payload<T>::value;
+#else
+template <class T>
+constexpr inline bool is_mapped_v = false;
+#endif
+
+template <class T>
+using heap_handler = std::conditional_t<is_pooled_v<T>, pooled_handler<T>,
+                                        std::conditional_t<is_mapped_v<T>, mapped_handler<T>, default_handler<T>>>;
+
+template <class T, std::size_t Size, std::size_t Align>
+using handler = std::conditional_t<is_small_object_v<T, Size, Align>, small_buffer_handler<T>, heap_handler<T>>;
 
 template <typename T>
 struct is_in_place_type : std::false_type {};
@@ -49,69 +283,322 @@ template <typename T>
 struct is_in_place_type<std::in_place_type_t<T>> : std::true_type {};
 template <typename T>
 inline constexpr bool is_in_place_type_v = is_in_place_type<T>::value;
+
+// Gives type-erased algorithms access to the payload and the vtable of a basic_unique_any.
+struct payload_access;
+
+template <class F, class R = std::invoke_result_t<F>>
+using factory_result_t = std::enable_if_t<!std::is_reference_v<R> && !std::is_void_v<R>, std::remove_cv_t<R>>;
+
+// Forwards the operations to the vtable_type returned by Derived::vtable().
+template <class Derived>
+struct table_handle_base {
+    void destroy(void *buf) const { self().vtable().destroy(buf); }
+    void move(void *src, void *dst) const { self().vtable().move(src, dst); }
+    [[nodiscard]] auto get(void *buf) const -> void * { return self().vtable().get(buf); }
+    [[nodiscard]] auto type() const -> const std::type_info & { return self().vtable().typeinfo; }
+    [[nodiscard]] auto key() const -> std::uint64_t { return self().vtable().key; }
+    [[nodiscard]] auto is_inline() const -> bool { return self().vtable().is_inline; }
+    // Also true for the empty state.
+    [[nodiscard]] auto is_trivially_relocatable() const -> bool {
+        return !self().has_value() || self().vtable().is_trivially_relocatable;
+    }
+    [[nodiscard]] auto hash_function() const -> std::size_t (*)(const void *) { return self().vtable().hash; }
+    [[nodiscard]] auto equal_function() const -> bool (*)(const void *, const void *) { return self().vtable().equal; }
+    [[nodiscard]] auto less_function() const -> bool (*)(const void *, const void *) { return self().vtable().less; }
+    [[nodiscard]] auto clone_function() const -> void (*)(const void *, void *) { return self().vtable().clone; }
+
+  private:
+    [[nodiscard]] auto self() const -> const Derived & { return static_cast<const Derived &>(*this); }
+};
+
+// Process-wide table backing index_dispatch. Index 0 means empty.
+inline auto vtable_registry() noexcept -> const vtable_type ** {
+    static const vtable_type *table[std::numeric_limits<std::uint16_t>::max() + 1] = {};
+    return table;
+}
+
+inline auto register_vtable(const vtable_type &vtable) -> std::uint16_t {
+    static auto next = std::atomic<std::uint32_t>(1);
+    auto index = next.fetch_add(1, std::memory_order_relaxed);
+    if (index > std::numeric_limits<std::uint16_t>::max()) {
+        throw std::length_error("mcpp::index_dispatch: too many payload types");
+    }
+    vtable_registry()[index] = &vtable;
+    return static_cast<std::uint16_t>(index);
+}
+
+template <class Handler>
+auto vtable_index() -> std::uint16_t {
+    static const auto index = register_vtable(Handler::vtable);
+    return index;
+}
+
+enum class manager_op { destroy, move, get, type, key, is_inline, is_trivially_relocatable, hash, equal, less, clone };
+
+// What a manager function returns for each manager_op.
+union manager_result {
+    void *ptr; // get
+    const std::type_info *type;
+    std::uint64_t key;
+    bool flag; // is_inline, is_trivially_relocatable
+    std::size_t (*hash)(const void *);
+    bool (*compare)(const void *, const void *); // equal, less
+    void (*clone)(const void *, void *);
+};
+
+// Single entry point for all operations of a handler, used by manager_dispatch. Does not refer to Handler::vtable, so
+// that the vtable is not instantiated for payload types that are only used with manager_dispatch.
+template <class Handler>
+auto manage(manager_op op, void *a, void *b) -> manager_result {
+    using T = typename Handler::value_type;
+    auto ret = manager_result{nullptr};
+    switch (op) {
+        case manager_op::destroy:
+            Handler::destroy(a);
+            break;
+        case manager_op::move:
+            Handler::move(a, b);
+            break;
+        case manager_op::get:
+            ret.ptr = Handler::get(a);
+            break;
+        case manager_op::type:
+            ret.type = &typeid(T);
+            break;
+        case manager_op::key:
+            ret.key = type_key_v<T>;
+            break;
+        case manager_op::is_inline:
+            ret.flag = Handler::is_inline;
+            break;
+        case manager_op::is_trivially_relocatable:
+            ret.flag = !Handler::is_inline || is_trivially_relocatable_v<T>;
+            break;
+        case manager_op::hash:
+            ret.hash = hash_entry<T>();
+            break;
+        case manager_op::equal:
+            ret.compare = equal_entry<T>();
+            break;
+        case manager_op::less:
+            ret.compare = less_entry<T>();
+            break;
+        case manager_op::clone:
+            ret.clone = clone_entry<Handler, T>();
+            break;
+    }
+    return ret;
+}
 } // namespace detail
 
-class unique_any {
+///////////////////////////////////////////////////////////////////////////////
+// Dispatch policies
+// A dispatch policy defines what basic_unique_any stores to find the operations for its payload type.
+
+// Stores a pointer to a static vtable per payload type. The lowest bit of the pointer is set if the payload is not
+// trivially relocatable, so that moves of trivially relocatable payloads do not need to load the vtable.
+struct vtable_dispatch {
+    class handle : public detail::table_handle_base<handle> {
+      public:
+        constexpr handle() noexcept = default;
+        template <class Handler>
+        static auto of() noexcept -> handle {
+            static_assert(alignof(detail::vtable_type) > 1);
+            return handle(reinterpret_cast<std::uintptr_t>(&Handler::vtable) |
+                          (Handler::vtable.is_trivially_relocatable ? 0U : 1U));
+        }
+        [[nodiscard]] constexpr auto has_value() const noexcept -> bool { return bits_ != 0; }
+        [[nodiscard]] auto vtable() const noexcept -> const detail::vtable_type & {
+            return *reinterpret_cast<const detail::vtable_type *>(bits_ & ~std::uintptr_t{1});
+        }
+        [[nodiscard]] constexpr auto is_trivially_relocatable() const noexcept -> bool { return (bits_ & 1U) == 0; }
+
+      private:
+        constexpr explicit handle(std::uintptr_t bits) noexcept : bits_(bits) {}
+        std::uintptr_t bits_ = 0;
+    };
+};
+
+// Stores a 16-bit index into a process-wide table of vtables instead of a pointer, which leaves more room for the
+// inline buffer. Each payload type is registered on first use, up to 65535 types. Indices are assigned per shared
+// object, so objects using this policy must not be passed across shared library boundaries.
+struct index_dispatch {
+    class handle : public detail::table_handle_base<handle> {
+      public:
+        constexpr handle() noexcept = default;
+        template <class Handler>
+        static auto of() -> handle {
+            return handle(detail::vtable_index<Handler>());
+        }
+        [[nodiscard]] constexpr auto has_value() const noexcept -> bool { return index_ != 0; }
+        [[nodiscard]] auto vtable() const noexcept -> const detail::vtable_type & {
+            return *detail::vtable_registry()[index_];
+        }
+
+      private:
+        constexpr explicit handle(std::uint16_t index) noexcept : index_(index) {}
+        std::uint16_t index_ = 0;
+    };
+};
+
+// Stores a pointer to a single manager function per payload type that performs every operation, like the std::any
+// implementations of libstdc++ and libc++. Each payload type instantiates this one function and no vtable, at the cost
+// of a switch per call.
+struct manager_dispatch {
+    class handle {
+      public:
+        using manager_type = detail::manager_result (*)(detail::manager_op, void *, void *);
+
+        constexpr handle() noexcept = default;
+        template <class Handler>
+        static constexpr auto of() noexcept -> handle {
+            return handle(&detail::manage<Handler>);
+        }
+        [[nodiscard]] constexpr auto has_value() const noexcept -> bool { return manager_ != nullptr; }
+        void destroy(void *buf) const { call(detail::manager_op::destroy, buf); }
+        void move(void *src, void *dst) const { call(detail::manager_op::move, src, dst); }
+        [[nodiscard]] auto get(void *buf) const -> void * { return call(detail::manager_op::get, buf).ptr; }
+        [[nodiscard]] auto type() const -> const std::type_info & { return *call(detail::manager_op::type).type; }
+        [[nodiscard]] auto key() const -> std::uint64_t { return call(detail::manager_op::key).key; }
+        [[nodiscard]] auto is_inline() const -> bool { return call(detail::manager_op::is_inline).flag; }
+        // Also true for the empty state.
+        [[nodiscard]] auto is_trivially_relocatable() const -> bool {
+            return !has_value() || call(detail::manager_op::is_trivially_relocatable).flag;
+        }
+        [[nodiscard]] auto hash_function() const -> std::size_t (*)(const void *) {
+            return call(detail::manager_op::hash).hash;
+        }
+        [[nodiscard]] auto equal_function() const -> bool (*)(const void *, const void *) {
+            return call(detail::manager_op::equal).compare;
+        }
+        [[nodiscard]] auto less_function() const -> bool (*)(const void *, const void *) {
+            return call(detail::manager_op::less).compare;
+        }
+        [[nodiscard]] auto clone_function() const -> void (*)(const void *, void *) {
+            return call(detail::manager_op::clone).clone;
+        }
+
+      private:
+        constexpr explicit handle(manager_type manager) noexcept : manager_(manager) {}
+        auto call(detail::manager_op op, void *a = nullptr, void *b = nullptr) const -> detail::manager_result {
+            return manager_(op, a, b);
+        }
+        manager_type manager_ = nullptr;
+    };
+};
+
+// Stores the destroy, move and get function pointers in the object itself, next to the vtable pointer. Saves the load
+// of the vtable on the hot operations, but makes the object three pointers larger.
+struct inline_dispatch {
+    class handle : public detail::table_handle_base<handle> {
+      public:
+        constexpr handle() noexcept = default;
+        template <class Handler>
+        static constexpr auto of() noexcept -> handle {
+            return handle(Handler::vtable);
+        }
+        [[nodiscard]] constexpr auto has_value() const noexcept -> bool { return vtable_ != nullptr; }
+        [[nodiscard]] auto vtable() const noexcept -> const detail::vtable_type & { return *vtable_; }
+        void destroy(void *buf) const { destroy_(buf); }
+        void move(void *src, void *dst) const { move_(src, dst); }
+        [[nodiscard]] auto get(void *buf) const -> void * { return get_(buf); }
+
+      private:
+        constexpr explicit handle(const detail::vtable_type &vtable) noexcept
+            : destroy_(&vtable.destroy), move_(&vtable.move), get_(&vtable.get), vtable_(&vtable) {}
+        void (*destroy_)(void *) = nullptr;
+        void (*move_)(void *, void *) = nullptr;
+        void *(*get_)(void *) = nullptr;
+        const detail::vtable_type *vtable_ = nullptr;
+    };
+};
+
+template <std::size_t Size, std::size_t Align, class Dispatch>
+class basic_unique_any;
+
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(const basic_unique_any<Size, Align, Dispatch> *operand) noexcept -> const T *;
+
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(basic_unique_any<Size, Align, Dispatch> *operand) noexcept -> T *;
+
+// unique_any with a configurable inline buffer and dispatch policy. Payloads that fit into Size bytes, whose alignment
+// divides Align and that are nothrow-movable are stored inline, all others on the heap.
+template <std::size_t Size, std::size_t Align, class Dispatch>
+class basic_unique_any {
+    static_assert(Size >= sizeof(void *) && Align % alignof(void *) == 0, "The buffer must be able to hold a pointer");
+
+    using handle_type = typename Dispatch::handle;
+    template <class T>
+    using handler = detail::handler<T, Size, Align>;
+
   public:
+    static constexpr inline std::size_t buffer_size = Size;
+    static constexpr inline std::size_t buffer_alignment = Align;
+
     ///////////////////////////////////////////////////////////////////////////
     // Constructors
     // https://en.cppreference.com/w/cpp/utility/any/any (1)
-    constexpr unique_any() noexcept : vtable_(nullptr) {}
+    constexpr basic_unique_any() noexcept : buf_{}, handle_() {}
     // https://en.cppreference.com/w/cpp/utility/any/any (2)
-    unique_any(const unique_any &other) = delete;
+    basic_unique_any(const basic_unique_any &other) = delete;
     // https://en.cppreference.com/w/cpp/utility/any/any (3)
-    unique_any(unique_any &&other) noexcept {
-        if (other.vtable_ != nullptr) {
-            other.vtable_->move(other.storage_, storage_);
-            vtable_ = std::exchange(other.vtable_, nullptr);
-        } else {
-            vtable_ = nullptr;
-        }
+    basic_unique_any(basic_unique_any &&other) noexcept : handle_(std::exchange(other.handle_, handle_type())) {
+        relocate(handle_, other.buf_, buf_);
     }
     // https://en.cppreference.com/w/cpp/utility/any/any (4)
     template <class ValueType, class T = std::decay_t<ValueType>,
-              class = std::enable_if_t<!std::is_same_v<T, unique_any> && !detail::is_in_place_type_v<T>>>
-    unique_any(ValueType &&value) : vtable_(&detail::handler<T>::vtable) {
-        detail::handler<T>::create(storage_, std::forward<ValueType>(value));
+              class = std::enable_if_t<!std::is_same_v<T, basic_unique_any> && !detail::is_in_place_type_v<T> &&
+                                       !std::is_same_v<T, from_factory_t>>>
+    basic_unique_any(ValueType &&value) : handle_(handle_type::template of<handler<T>>()) {
+        handler<T>::create(buf_, std::forward<ValueType>(value));
     }
     // https://en.cppreference.com/w/cpp/utility/any/any (5)
     template <class ValueType, class... Args, class T = std::decay_t<ValueType>,
               class = std::enable_if_t<std::is_constructible_v<T, Args...>>>
-    explicit unique_any(std::in_place_type_t<ValueType> /*unused*/, Args &&...args)
-        : vtable_(&detail::handler<T>::vtable) {
-        detail::handler<T>::create(storage_, std::forward<Args>(args)...);
+    explicit basic_unique_any(std::in_place_type_t<ValueType> /*unused*/, Args &&...args)
+        : handle_(handle_type::template of<handler<T>>()) {
+        handler<T>::create(buf_, std::forward<Args>(args)...);
     }
     // https://en.cppreference.com/w/cpp/utility/any/any (6)
     template <class ValueType, class U, class... Args, class T = std::decay_t<ValueType>,
               class = std::enable_if_t<std::is_constructible_v<T, std::initializer_list<U> &, Args...>>>
-    explicit unique_any(std::in_place_type_t<ValueType> /*unused*/, std::initializer_list<U> il, Args &&...args)
-        : vtable_(&detail::handler<T>::vtable) {
-        detail::handler<T>::create(storage_, il, std::forward<Args>(args)...);
+    explicit basic_unique_any(std::in_place_type_t<ValueType> /*unused*/, std::initializer_list<U> il,
+                              Args &&...args)
+        : handle_(handle_type::template of<handler<T>>()) {
+        handler<T>::create(buf_, il, std::forward<Args>(args)...);
+    }
+    // Constructs the payload directly from the prvalue returned by factory(), without any intermediate object. This
+    // also works for types that are neither copyable nor movable.
+    template <class F, class T = detail::factory_result_t<F>>
+    basic_unique_any(from_factory_t /*unused*/, F &&factory) : handle_(handle_type::template of<handler<T>>()) {
+        handler<T>::create_from(buf_, std::forward<F>(factory));
     }
 
     ///////////////////////////////////////////////////////////////////////////
     // Assignment operators
     // https://en.cppreference.com/w/cpp/utility/any/operator%3D (1)
-    auto operator=(const unique_any &rhs) -> unique_any & = delete;
+    auto operator=(const basic_unique_any &rhs) -> basic_unique_any & = delete;
     // https://en.cppreference.com/w/cpp/utility/any/operator%3D (2)
-    auto operator=(unique_any &&rhs) noexcept -> unique_any & {
-        unique_any(std::move(rhs)).swap(*this);
+    auto operator=(basic_unique_any &&rhs) noexcept -> basic_unique_any & {
+        basic_unique_any(std::move(rhs)).swap(*this);
         return *this;
     }
     // https://en.cppreference.com/w/cpp/utility/any/operator%3D (3)
     template <typename ValueType, class T = std::decay_t<ValueType>,
-              class = std::enable_if_t<!std::is_same_v<T, unique_any>>>
-    auto operator=(ValueType &&rhs) -> unique_any & {
-        unique_any(std::forward<ValueType>(rhs)).swap(*this);
+              class = std::enable_if_t<!std::is_same_v<T, basic_unique_any>>>
+    auto operator=(ValueType &&rhs) -> basic_unique_any & {
+        basic_unique_any(std::forward<ValueType>(rhs)).swap(*this);
         return *this;
     }
 
     ///////////////////////////////////////////////////////////////////////////
     // Destructor
     // https://en.cppreference.com/w/cpp/utility/any/~any
-    ~unique_any() {
-        if (vtable_ != nullptr) {
-            vtable_->destroy(storage_);
+    ~basic_unique_any() {
+        if (handle_.has_value()) {
+            handle_.destroy(buf_);
         }
     }
 
@@ -121,108 +608,196 @@ class unique_any {
     template <class ValueType, class... Args, class T = std::decay_t<ValueType>,
               class = std::enable_if_t<std::is_constructible_v<T, Args...>>>
     auto emplace(Args &&...args) -> T & {
-        if (vtable_ != nullptr) {
-            vtable_->destroy(storage_);
+        if (handle_.has_value()) {
+            handle_.destroy(buf_);
         }
-        vtable_ = &detail::handler<T>::vtable;
-        return detail::handler<T>::create(storage_, std::forward<Args>(args)...);
+        handle_ = handle_type::template of<handler<T>>();
+        return handler<T>::create(buf_, std::forward<Args>(args)...);
     }
     // https://en.cppreference.com/w/cpp/utility/any/emplace (2)
     template <class ValueType, class U, class... Args, class T = std::decay_t<ValueType>,
               class = std::enable_if_t<std::is_constructible_v<T, std::initializer_list<U> &, Args...>>>
     auto emplace(std::initializer_list<U> il, Args &&...args) -> T & {
-        if (vtable_ != nullptr) {
-            vtable_->destroy(storage_);
+        if (handle_.has_value()) {
+            handle_.destroy(buf_);
         }
-        vtable_ = &detail::handler<T>::vtable;
-        return detail::handler<T>::create(storage_, il, std::forward<Args>(args)...);
+        handle_ = handle_type::template of<handler<T>>();
+        return handler<T>::create(buf_, il, std::forward<Args>(args)...);
+    }
+    // Like basic_unique_any(from_factory_t, F &&), but replaces the current payload.
+    template <class F, class T = detail::factory_result_t<F>>
+    auto emplace_from(F &&factory) -> T & {
+        reset();
+        auto handle = handle_type::template of<handler<T>>();
+        auto &ret = handler<T>::create_from(buf_, std::forward<F>(factory));
+        handle_ = handle;
+        return ret;
     }
     // https://en.cppreference.com/w/cpp/utility/any/reset
     void reset() noexcept {
-        if (vtable_ != nullptr) {
-            vtable_->destroy(storage_);
-            vtable_ = nullptr;
+        if (handle_.has_value()) {
+            handle_.destroy(buf_);
+            handle_ = handle_type();
         }
     }
     // https://en.cppreference.com/w/cpp/utility/any/swap
-    void swap(unique_any &other) noexcept {
+    void swap(basic_unique_any &other) noexcept {
         if (this == &other) {
             return;
         }
-        if (vtable_ == nullptr && other.vtable_ == nullptr) {
+        if (!handle_.has_value() && !other.handle_.has_value()) {
             return;
         }
-        if (vtable_ != nullptr && other.vtable_ != nullptr) {
-            auto tmp = detail::storage();
-            other.vtable_->move(other.storage_, tmp);
-            vtable_->move(storage_, other.storage_);
-            other.vtable_->move(tmp, storage_);
-        } else if (vtable_ != nullptr) {
-            vtable_->move(storage_, other.storage_);
-        } else if (other.vtable_ != nullptr) {
-            other.vtable_->move(other.storage_, storage_);
+        if (handle_.has_value() && other.handle_.has_value()) {
+            alignas(Align) unsigned char tmp[Size];
+            relocate(other.handle_, other.buf_, tmp);
+            relocate(handle_, buf_, other.buf_);
+            relocate(other.handle_, tmp, buf_);
+        } else if (handle_.has_value()) {
+            relocate(handle_, buf_, other.buf_);
+        } else if (other.handle_.has_value()) {
+            relocate(other.handle_, other.buf_, buf_);
         }
-        std::swap(vtable_, other.vtable_);
+        std::swap(handle_, other.handle_);
     }
 
     ///////////////////////////////////////////////////////////////////////////
     // Observers
     // https://en.cppreference.com/w/cpp/utility/any/has_value
-    [[nodiscard]] auto has_value() const noexcept -> bool { return vtable_ != nullptr; }
+    [[nodiscard]] auto has_value() const noexcept -> bool { return handle_.has_value(); }
     // https://en.cppreference.com/w/cpp/utility/any/type
     [[nodiscard]] auto type() const noexcept -> const std::type_info & {
-        return vtable_ != nullptr ? vtable_->typeinfo : typeid(void);
+        return handle_.has_value() ? handle_.type() : typeid(void);
+    }
+    // Stable key of the payload type (type_key_v<void> if empty). Unlike type(), it can be compared across shared
+    // library boundaries without string comparisons.
+    [[nodiscard]] auto type_key() const noexcept -> std::uint64_t {
+        return handle_.has_value() ? handle_.key() : type_key_v<void>;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Extensions
+    // Hints the CPU to start loading a heap-placed payload into cache. No-op for empty objects and inline payloads.
+    void prefetch() const noexcept {
+        if (handle_.has_value() && !handle_.is_inline()) {
+            detail::prefetch(detail::load_ptr(buf_));
+        }
+    }
+    // std::hash of the payload, or 0 if empty. Equal to std::hash<T>{}(value) for a payload value of type T, so that
+    // plain values can be used to look up objects in hash tables. Throws std::logic_error if T has no std::hash or is
+    // not is_equality_comparable.
+    [[nodiscard]] auto hash() const -> std::size_t {
+        if (!handle_.has_value()) {
+            return 0;
+        }
+        auto *hash = handle_.hash_function();
+        if (hash == nullptr) {
+            throw std::logic_error("mcpp::unique_any: payload type is not hashable");
+        }
+        return hash(unsafe_cast<void>());
+    }
+    // Copy of this object if its payload is cloneable (see is_cloneable), otherwise an empty object. Small payloads are
+    // copied into the inline buffer of the result, others are allocated like any other heap-placed payload.
+    [[nodiscard]] auto try_clone() const -> basic_unique_any {
+        auto ret = basic_unique_any();
+        if (handle_.has_value()) {
+            if (auto *clone = handle_.clone_function()) {
+                clone(buf_, ret.buf_);
+                ret.handle_ = handle_;
+            }
+        }
+        return ret;
     }
 
   private:
+    // Moves the payload described by handle from src to dst, leaving src without a payload. Trivially relocatable
+    // payloads (including heap-placed ones) and the empty state are copied bytewise without any indirect call.
+    static void relocate(const handle_type &handle, void *src, void *dst) noexcept {
+        if (handle.is_trivially_relocatable()) {
+            std::memcpy(dst, src, Size);
+        } else {
+            handle.move(src, dst);
+        }
+    }
+
     template <typename T>
     auto unsafe_cast() -> T * {
-        return static_cast<T *>(vtable_->get(storage_));
+        return static_cast<T *>(handle_.get(buf_));
     }
 
     template <typename T>
     auto unsafe_cast() const -> const T * {
-        return const_cast<unique_any *>(this)->unsafe_cast<T>();
+        return const_cast<basic_unique_any *>(this)->template unsafe_cast<T>();
     }
 
-    template <typename T>
-    friend auto any_cast(const unique_any *operand) noexcept -> const T *;
+    template <class T, std::size_t S, std::size_t A, class D>
+    friend auto any_cast(const basic_unique_any<S, A, D> *operand) noexcept -> const T *;
 
-    template <typename T>
-    friend auto any_cast(unique_any *operand) noexcept -> T *;
+    template <class T, std::size_t S, std::size_t A, class D>
+    friend auto any_cast(basic_unique_any<S, A, D> *operand) noexcept -> T *;
+
+    friend struct detail::payload_access;
 
-    const detail::vtable_type *vtable_;
-    detail::storage storage_;
+    alignas(Align) unsigned char buf_[Size];
+    handle_type handle_;
 };
 
+// Four pointers in size, three of which are available for inline payloads.
+using unique_any = basic_unique_any<3 * sizeof(void *), alignof(void *), vtable_dispatch>;
+
+// Same size as unique_any, but stores a 16-bit type index instead of the vtable pointer, so payloads of up to 30 bytes
+// (on 64-bit platforms) are stored inline. See index_dispatch for its restrictions.
+using compact_unique_any =
+    basic_unique_any<4 * sizeof(void *) - sizeof(std::uint16_t), alignof(void *), index_dispatch>;
+
+// Occupies and is aligned to a whole 64-byte cache line, so that objects in arrays never share a cache line. Payloads
+// of up to 56 bytes (on 64-bit platforms) are stored inline, including ones aligned to up to 32 bytes. Payloads aligned
+// to 64 bytes are at least 64 bytes large, so they are always heap-placed.
+using cacheline_unique_any = basic_unique_any<64 - sizeof(void *), 64, vtable_dispatch>;
+
+// Two pointers in size, for large arrays of handles: only pointer-sized payloads are stored inline. Moving an object
+// with a trivially relocatable or heap-placed payload copies 16 bytes (on 64-bit platforms) without any indirect call.
+using slim_unique_any = basic_unique_any<sizeof(void *), alignof(void *), vtable_dispatch>;
+
 namespace detail {
 template <class T>
 struct small_buffer_handler {
   private:
     using allocator = std::allocator<T>;
     using allocator_traits = std::allocator_traits<allocator>;
-    static auto cast(storage &s) -> T * { return static_cast<T *>(static_cast<void *>(&s.buf)); }
-    static void destroy(storage &s) {
+    static auto cast(void *buf) -> T * { return static_cast<T *>(buf); }
+
+  public:
+    using value_type = T;
+    static constexpr inline bool is_inline = true;
+
+    static void destroy(void *buf) {
         auto alloc = allocator{};
-        allocator_traits::destroy(alloc, cast(s));
+        allocator_traits::destroy(alloc, cast(buf));
     }
-    static void move(storage &src, storage &dst) {
+    static void move(void *src, void *dst) {
         auto alloc = allocator{};
         allocator_traits::construct(alloc, cast(dst), std::move(*cast(src)));
         allocator_traits::destroy(alloc, cast(src));
     }
-    static auto get(storage &s) -> void * { return cast(s); }
+    static auto get(void *buf) -> void * { return cast(buf); }
 
-  public:
-    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T)};
+    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T), type_key_v<T>, is_inline,
+                                                  is_trivially_relocatable_v<T>, hash_entry<T>(), equal_entry<T>(),
+                                                  less_entry<T>(), clone_entry<small_buffer_handler, T>()};
 
     template <class... Args>
-    static auto create(storage &s, Args &&...args) -> T & {
+    static auto create(void *buf, Args &&...args) -> T & {
         auto alloc = allocator{};
-        auto *ret = cast(s);
+        auto *ret = cast(buf);
         allocator_traits::construct(alloc, ret, std::forward<Args>(args)...);
         return *ret;
     }
+
+    template <class F>
+    static auto create_from(void *buf, F &&factory) -> T & {
+        return *::new (buf) T(std::forward<F>(factory)());
+    }
 };
 
 template <typename Allocator, typename std::allocator_traits<Allocator>::size_type size>
@@ -238,39 +813,345 @@ struct default_handler {
   private:
     using allocator = std::allocator<T>;
     using allocator_traits = std::allocator_traits<allocator>;
-    static void destroy(storage &s) {
+    static auto cast(void *buf) -> T * { return static_cast<T *>(load_ptr(buf)); }
+
+  public:
+    using value_type = T;
+    static constexpr inline bool is_inline = false;
+
+    static void destroy(void *buf) {
         auto alloc = allocator{};
-        auto *ptr = static_cast<T *>(s.ptr);
+        auto *ptr = cast(buf);
         allocator_traits::destroy(alloc, ptr);
         allocator_traits::deallocate(alloc, ptr, 1);
     }
-    static void move(storage &src, storage &dst) { dst.ptr = src.ptr; }
-    static auto get(storage &s) -> void * { return s.ptr; }
+    static void move(void *src, void *dst) { store_ptr(dst, load_ptr(src)); }
+    static auto get(void *buf) -> void * { return load_ptr(buf); }
 
-  public:
-    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T)};
+    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T), type_key_v<T>, is_inline, true,
+                                                  hash_entry<T>(), equal_entry<T>(), less_entry<T>(),
+                                                  clone_entry<default_handler, T>()};
 
     template <class... Args>
-    static auto create(storage &s, Args &&...args) -> T & {
+    static auto create(void *buf, Args &&...args) -> T & {
         auto alloc = allocator{};
         auto holder = std::unique_ptr<T, allocator_deleter<allocator, 1>>(allocator_traits::allocate(alloc, 1));
         auto *ptr = holder.get();
         allocator_traits::construct(alloc, ptr, std::forward<Args>(args)...);
-        s.ptr = holder.release();
+        store_ptr(buf, holder.release());
+        return *ptr;
+    }
+
+    template <class F>
+    static auto create_from(void *buf, F &&factory) -> T & {
+        auto alloc = allocator{};
+        auto holder = std::unique_ptr<T, allocator_deleter<allocator, 1>>(allocator_traits::allocate(alloc, 1));
+        auto *ptr = ::new (static_cast<void *>(holder.get())) T(std::forward<F>(factory)());
+        holder.release();
+        store_ptr(buf, ptr);
+        return *ptr;
+    }
+};
+
+// Like default_handler, but recycles payloads through a thread-local pool, see pool_traits.
+template <class T>
+struct pooled_handler {
+  private:
+    using traits = pool_traits<T>;
+    using allocator = std::allocator<T>;
+    using allocator_traits = std::allocator_traits<allocator>;
+    static_assert(noexcept(traits::reset(std::declval<T &>())), "pool_traits<T>::reset must be noexcept");
+
+    struct pool {
+        pool() { items.reserve(traits::capacity); }
+        pool(const pool &other) = delete;
+        auto operator=(const pool &rhs) -> pool & = delete;
+        ~pool() {
+            destroyed = true;
+            for (auto *ptr : items) {
+                free(ptr);
+            }
+        }
+        std::vector<T *> items;
+    };
+
+    // Payloads destroyed during thread exit after the pool itself are freed directly.
+    static inline thread_local bool destroyed = false;
+
+    static auto local_pool() -> pool & {
+        static thread_local pool instance;
+        return instance;
+    }
+
+    static void free(T *ptr) noexcept {
+        auto alloc = allocator{};
+        allocator_traits::destroy(alloc, ptr);
+        allocator_traits::deallocate(alloc, ptr, 1);
+    }
+
+    static auto cast(void *buf) -> T * { return static_cast<T *>(load_ptr(buf)); }
+
+  public:
+    using value_type = T;
+    static constexpr inline bool is_inline = false;
+
+    static void destroy(void *buf) {
+        auto *ptr = cast(buf);
+        if (!destroyed) {
+            auto &items = local_pool().items;
+            if (items.size() < traits::capacity) {
+                traits::reset(*ptr);
+                items.push_back(ptr); // Never reallocates, capacity is reserved up front
+                return;
+            }
+        }
+        free(ptr);
+    }
+    static void move(void *src, void *dst) { store_ptr(dst, load_ptr(src)); }
+    static auto get(void *buf) -> void * { return load_ptr(buf); }
+
+    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T), type_key_v<T>, is_inline, true,
+                                                  hash_entry<T>(), equal_entry<T>(), less_entry<T>(),
+                                                  clone_entry<pooled_handler, T>()};
+
+    template <class... Args>
+    static auto create(void *buf, Args &&...args) -> T & {
+        if constexpr (sizeof...(Args) == 0) {
+            if (!destroyed) {
+                auto &items = local_pool().items;
+                if (!items.empty()) {
+                    auto *ptr = items.back();
+                    items.pop_back();
+                    store_ptr(buf, ptr);
+                    return *ptr;
+                }
+            }
+        }
+        return default_handler<T>::create(buf, std::forward<Args>(args)...);
+    }
+
+    template <class F>
+    static auto create_from(void *buf, F &&factory) -> T & {
+        return default_handler<T>::create_from(buf, std::forward<F>(factory));
+    }
+};
+
+#if defined(__linux__)
+constexpr inline std::size_t huge_page_size = std::size_t{2} << 20;
+
+// Maps size bytes of fresh memory, aligned to huge pages if it is large enough to contain at least one of them.
+inline auto map_pages(std::size_t size) -> void * {
+    auto alignment = size >= huge_page_size ? huge_page_size : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto mapped_size = size + alignment;
+    auto *mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    // Trim the mapping to an aligned range, so the kernel can back it with huge pages.
+    auto begin = reinterpret_cast<std::uintptr_t>(mapped);
+    auto aligned = (begin + alignment - 1) / alignment * alignment;
+    auto end = (aligned + size + alignment - 1) / alignment * alignment;
+    if (aligned != begin) {
+        ::munmap(mapped, aligned - begin);
+    }
+    if (end != begin + mapped_size) {
+        ::munmap(reinterpret_cast<void *>(end), begin + mapped_size - end);
+    }
+#if defined(MADV_HUGEPAGE)
+    if (alignment == huge_page_size) {
+        ::madvise(reinterpret_cast<void *>(aligned), end - aligned, MADV_HUGEPAGE);
+    }
+#endif
+    return reinterpret_cast<void *>(aligned);
+}
+
+inline void unmap_pages(void *ptr, std::size_t size) noexcept {
+    auto alignment = size >= huge_page_size ? huge_page_size : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    ::munmap(ptr, (size + alignment - 1) / alignment * alignment);
+}
+
+// Like default_handler, but each payload lives in its own memory mapping, see is_huge_payload.
+template <class T>
+struct mapped_handler {
+  private:
+    static_assert(alignof(T) <= 4096);
+
+    struct unmapper {
+        void operator()(void *ptr) const noexcept { unmap_pages(ptr, sizeof(T)); }
+    };
+
+    static auto cast(void *buf) -> T * { return static_cast<T *>(load_ptr(buf)); }
+
+  public:
+    using value_type = T;
+    static constexpr inline bool is_inline = false;
+
+    static void destroy(void *buf) {
+        auto *ptr = cast(buf);
+        ptr->~T();
+        unmap_pages(ptr, sizeof(T));
+    }
+    static void move(void *src, void *dst) { store_ptr(dst, load_ptr(src)); }
+    static auto get(void *buf) -> void * { return load_ptr(buf); }
+
+    static constexpr inline vtable_type vtable = {destroy, move, get, typeid(T), type_key_v<T>, is_inline, true,
+                                                  hash_entry<T>(), equal_entry<T>(), less_entry<T>(),
+                                                  clone_entry<mapped_handler, T>()};
+
+    template <class... Args>
+    static auto create(void *buf, Args &&...args) -> T & {
+        auto holder = std::unique_ptr<void, unmapper>(map_pages(sizeof(T)));
+        auto *ptr = ::new (holder.get()) T(std::forward<Args>(args)...);
+        store_ptr(buf, holder.release());
+        return *ptr;
+    }
+
+    template <class F>
+    static auto create_from(void *buf, F &&factory) -> T & {
+        auto holder = std::unique_ptr<void, unmapper>(map_pages(sizeof(T)));
+        auto *ptr = ::new (holder.get()) T(std::forward<F>(factory)());
+        store_ptr(buf, holder.release());
         return *ptr;
     }
 };
+#endif
 
 } // namespace detail
 
 // https://en.cppreference.com/w/cpp/utility/any/swap2
-inline void swap(unique_any &lhs, unique_any &rhs) noexcept {
+template <std::size_t Size, std::size_t Align, class Dispatch>
+void swap(basic_unique_any<Size, Align, Dispatch> &lhs, basic_unique_any<Size, Align, Dispatch> &rhs) noexcept {
     lhs.swap(rhs);
 }
 
+namespace detail {
+struct payload_access {
+    // Operations of the payload type, see table_handle_base. Must only be called on objects with a value.
+    template <std::size_t Size, std::size_t Align, class Dispatch>
+    static auto handle(const basic_unique_any<Size, Align, Dispatch> &any) noexcept
+        -> const typename Dispatch::handle & {
+        return any.handle_;
+    }
+    template <std::size_t Size, std::size_t Align, class Dispatch>
+    static auto get(const basic_unique_any<Size, Align, Dispatch> &any) noexcept -> const void * {
+        return any.template unsafe_cast<void>();
+    }
+    // Like get(), but without an indirect call, for callers that already know where payloads of this type are stored.
+    template <std::size_t Size, std::size_t Align, class Dispatch>
+    static auto get(const basic_unique_any<Size, Align, Dispatch> &any, bool is_inline) noexcept -> const void * {
+        return is_inline ? static_cast<const void *>(any.buf_) : load_ptr(any.buf_);
+    }
+};
+
+// Orders empty objects first, then by type key. Returns 0 if both objects are empty or have the same payload type.
+template <std::size_t Size, std::size_t Align, class Dispatch>
+auto compare_types(const basic_unique_any<Size, Align, Dispatch> &lhs,
+                   const basic_unique_any<Size, Align, Dispatch> &rhs) -> int {
+    if (!lhs.has_value() || !rhs.has_value()) {
+        return static_cast<int>(lhs.has_value()) - static_cast<int>(rhs.has_value());
+    }
+    auto lhs_key = lhs.type_key();
+    auto rhs_key = rhs.type_key();
+    if (lhs_key != rhs_key) {
+        return lhs_key < rhs_key ? -1 : 1;
+    }
+    // Types without a unique key (see has_unique_type_key_v) are ordered by the address of their type_info objects.
+    const auto *lhs_type = &lhs.type();
+    const auto *rhs_type = &rhs.type();
+    if (is_unique_type_key(lhs_key) || lhs_type == rhs_type) {
+        return 0;
+    }
+    return std::less<>()(lhs_type, rhs_type) ? -1 : 1;
+}
+} // namespace detail
+
+// Total order over objects with the same buffer and dispatch policy: empty objects come first, payloads of different
+// types are ordered by their type keys (see compare_types for types without a unique key), and payloads of the same
+// type by operator<. Returns a negative number, zero or a positive number if lhs is less than, equivalent to or
+// greater than rhs. Throws std::logic_error if the payloads have the same type, but it is not is_less_than_comparable.
+template <std::size_t Size, std::size_t Align, class Dispatch>
+auto three_way_compare(const basic_unique_any<Size, Align, Dispatch> &lhs,
+                       const basic_unique_any<Size, Align, Dispatch> &rhs) -> int {
+    if (auto ret = detail::compare_types(lhs, rhs); ret != 0 || !lhs.has_value()) {
+        return ret;
+    }
+    auto *less = detail::payload_access::handle(lhs).less_function();
+    if (less == nullptr) {
+        throw std::logic_error("mcpp::unique_any: payload type is not less-than comparable");
+    }
+    auto *lhs_payload = detail::payload_access::get(lhs);
+    auto *rhs_payload = detail::payload_access::get(rhs);
+    return less(lhs_payload, rhs_payload) ? -1 : (less(rhs_payload, lhs_payload) ? 1 : 0);
+}
+
+// Strict weak ordering by three_way_compare(), for ordered containers and algorithms.
+struct any_less {
+    template <std::size_t Size, std::size_t Align, class Dispatch>
+    auto operator()(const basic_unique_any<Size, Align, Dispatch> &lhs,
+                    const basic_unique_any<Size, Align, Dispatch> &rhs) const -> bool {
+        return three_way_compare(lhs, rhs) < 0;
+    }
+};
+
+// Objects are equal if both are empty, or if their payloads have the same type and compare equal with operator==.
+// Throws std::logic_error if the payloads have the same type, but it is not is_equality_comparable.
+template <std::size_t Size, std::size_t Align, class Dispatch>
+auto operator==(const basic_unique_any<Size, Align, Dispatch> &lhs, const basic_unique_any<Size, Align, Dispatch> &rhs)
+    -> bool {
+    if (!lhs.has_value() || !rhs.has_value()) {
+        return lhs.has_value() == rhs.has_value();
+    }
+    if (detail::compare_types(lhs, rhs) != 0) {
+        return false;
+    }
+    auto *equal = detail::payload_access::handle(lhs).equal_function();
+    if (equal == nullptr) {
+        throw std::logic_error("mcpp::unique_any: payload type is not equality comparable");
+    }
+    return equal(detail::payload_access::get(lhs), detail::payload_access::get(rhs));
+}
+
+template <std::size_t Size, std::size_t Align, class Dispatch>
+auto operator!=(const basic_unique_any<Size, Align, Dispatch> &lhs, const basic_unique_any<Size, Align, Dispatch> &rhs)
+    -> bool {
+    return !(lhs == rhs);
+}
+
+namespace detail {
+template <class T, class Any>
+using comparable_value_t =
+    std::enable_if_t<std::conjunction_v<std::negation<std::is_same<T, Any>>, is_equality_comparable<T>>>;
+} // namespace detail
+
+// Compares the payload with a plain value without boxing it. False if the payload has a different type.
+template <class T, std::size_t Size, std::size_t Align, class Dispatch,
+          class = detail::comparable_value_t<T, basic_unique_any<Size, Align, Dispatch>>>
+auto operator==(const basic_unique_any<Size, Align, Dispatch> &lhs, const T &rhs) -> bool {
+    auto *ptr = any_cast<T>(&lhs);
+    return ptr != nullptr && static_cast<bool>(*ptr == rhs);
+}
+
+template <class T, std::size_t Size, std::size_t Align, class Dispatch,
+          class = detail::comparable_value_t<T, basic_unique_any<Size, Align, Dispatch>>>
+auto operator==(const T &lhs, const basic_unique_any<Size, Align, Dispatch> &rhs) -> bool {
+    return rhs == lhs;
+}
+
+template <class T, std::size_t Size, std::size_t Align, class Dispatch,
+          class = detail::comparable_value_t<T, basic_unique_any<Size, Align, Dispatch>>>
+auto operator!=(const basic_unique_any<Size, Align, Dispatch> &lhs, const T &rhs) -> bool {
+    return !(lhs == rhs);
+}
+
+template <class T, std::size_t Size, std::size_t Align, class Dispatch,
+          class = detail::comparable_value_t<T, basic_unique_any<Size, Align, Dispatch>>>
+auto operator!=(const T &lhs, const basic_unique_any<Size, Align, Dispatch> &rhs) -> bool {
+    return !(rhs == lhs);
+}
+
 // https://en.cppreference.com/w/cpp/utility/any/any_cast (1)
-template <class T>
-auto any_cast(const unique_any &operand) -> T {
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(const basic_unique_any<Size, Align, Dispatch> &operand) -> T {
     using U = std::remove_cv_t<std::remove_reference_t<T>>;
     static_assert(std::is_constructible_v<T, const U &>);
     if (auto ptr = any_cast<std::add_const_t<U>>(&operand)) {
@@ -280,8 +1161,8 @@ auto any_cast(const unique_any &operand) -> T {
 }
 
 // https://en.cppreference.com/w/cpp/utility/any/any_cast (2)
-template <class T>
-auto any_cast(unique_any &operand) -> T {
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(basic_unique_any<Size, Align, Dispatch> &operand) -> T {
     using U = std::remove_cv_t<std::remove_reference_t<T>>;
     static_assert(std::is_constructible_v<T, U &>);
     if (auto ptr = any_cast<U>(&operand)) {
@@ -291,8 +1172,8 @@ auto any_cast(unique_any &operand) -> T {
 }
 
 // https://en.cppreference.com/w/cpp/utility/any/any_cast (3)
-template <class T>
-auto any_cast(unique_any &&operand) -> T {
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(basic_unique_any<Size, Align, Dispatch> &&operand) -> T {
     using U = std::remove_cv_t<std::remove_reference_t<T>>;
     static_assert(std::is_constructible_v<T, U>);
     if (auto ptr = any_cast<U>(&operand)) {
@@ -302,21 +1183,23 @@ auto any_cast(unique_any &&operand) -> T {
 }
 
 // https://en.cppreference.com/w/cpp/utility/any/any_cast (4)
-template <class T>
-auto any_cast(const unique_any *operand) noexcept -> const T * {
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(const basic_unique_any<Size, Align, Dispatch> *operand) noexcept -> const T * {
     static_assert(!std::is_reference_v<T>);
-    if (operand && operand->type() == typeid(T)) {
-        return operand->unsafe_cast<T>();
+    if (operand && operand->has_value() &&
+        detail::is_type<std::remove_cv_t<T>>(operand->handle_.key(), operand->handle_.type())) {
+        return operand->template unsafe_cast<T>();
     }
     return nullptr;
 }
 
 // https://en.cppreference.com/w/cpp/utility/any/any_cast (5)
-template <class T>
-auto any_cast(unique_any *operand) noexcept -> T * {
+template <class T, std::size_t Size, std::size_t Align, class Dispatch>
+auto any_cast(basic_unique_any<Size, Align, Dispatch> *operand) noexcept -> T * {
     static_assert(!std::is_reference_v<T>);
-    if (operand && operand->type() == typeid(T)) {
-        return operand->unsafe_cast<T>();
+    if (operand && operand->has_value() &&
+        detail::is_type<std::remove_cv_t<T>>(operand->handle_.key(), operand->handle_.type())) {
+        return operand->template unsafe_cast<T>();
     }
     return nullptr;
 }
@@ -333,4 +1216,23 @@ auto make_unique_any(std::initializer_list<U> il, Args &&...args) -> unique_any
     return unique_any(std::in_place_type<T>, il, std::forward<Args>(args)...);
 }
 
-} // namespace mcpp
\ No newline at end of file
+} // namespace mcpp
+
+// Hashes the payload, see basic_unique_any::hash(). Transparent, so that hash tables of unique_any with a transparent
+// key equality such as std::equal_to<> can be searched for plain values without boxing them (from C++20 on).
+namespace std {
+template <std::size_t Size, std::size_t Align, class Dispatch>
+struct hash<mcpp::basic_unique_any<Size, Align, Dispatch>> {
+    using is_transparent = void;
+
+    auto operator()(const mcpp::basic_unique_any<Size, Align, Dispatch> &value) const -> std::size_t {
+        return value.hash();
+    }
+    template <class T, class = std::enable_if_t<std::conjunction_v<
+                           std::negation<std::is_same<T, mcpp::basic_unique_any<Size, Align, Dispatch>>>,
+                           mcpp::detail::is_hashable<T>>>>
+    auto operator()(const T &value) const -> std::size_t {
+        return std::hash<T>{}(value);
+    }
+};
+} // namespace std
@@ -0,0 +1,139 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// <span> warns when included in C++17 mode with MSVC, so only include it in C++20 mode.
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <span>
+#endif
+
+namespace mcpp {
+
+// Owning array of n elements whose count lives in the same heap block as the elements, so that it costs a single
+// allocation. The object itself is a single pointer, so in a unique_any it is stored inline and moved with memcpy.
+template <class T>
+class unique_array {
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    constexpr unique_array() noexcept = default;
+    // Constructs n elements from args, which are passed to each of them as lvalues.
+    template <class... Args>
+    explicit unique_array(size_type n, const Args &...args) {
+        if (n == 0) {
+            return;
+        }
+        auto *block = allocate(n);
+        auto *elements = reinterpret_cast<T *>(block + elements_offset);
+        auto i = size_type{0};
+        try {
+            for (; i < n; ++i) {
+                ::new (static_cast<void *>(elements + i)) T(args...);
+            }
+        } catch (...) {
+            destroy(elements, i);
+            deallocate(block, n);
+            throw;
+        }
+        ::new (static_cast<void *>(block)) size_type(n);
+        data_ = elements;
+    }
+    unique_array(const unique_array &other) = delete;
+    unique_array(unique_array &&other) noexcept : data_(std::exchange(other.data_, nullptr)) {}
+    auto operator=(const unique_array &rhs) -> unique_array & = delete;
+    auto operator=(unique_array &&rhs) noexcept -> unique_array & {
+        unique_array(std::move(rhs)).swap(*this);
+        return *this;
+    }
+    ~unique_array() {
+        if (data_ != nullptr) {
+            auto n = size();
+            destroy(data_, n);
+            deallocate(block(), n);
+        }
+    }
+
+    void swap(unique_array &other) noexcept { std::swap(data_, other.data_); }
+
+    [[nodiscard]] auto size() const noexcept -> size_type {
+        return data_ == nullptr ? 0 : *reinterpret_cast<const size_type *>(block());
+    }
+    [[nodiscard]] auto empty() const noexcept -> bool { return data_ == nullptr; }
+    [[nodiscard]] auto data() noexcept -> T * { return data_; }
+    [[nodiscard]] auto data() const noexcept -> const T * { return data_; }
+    auto operator[](size_type i) noexcept -> T & { return data_[i]; }
+    auto operator[](size_type i) const noexcept -> const T & { return data_[i]; }
+    auto begin() noexcept -> iterator { return data_; }
+    auto begin() const noexcept -> const_iterator { return data_; }
+    auto end() noexcept -> iterator { return data_ + size(); }
+    auto end() const noexcept -> const_iterator { return data_ + size(); }
+
+#if defined(__cpp_lib_span)
+    operator std::span<T>() noexcept { return {data_, size()}; }
+    operator std::span<const T>() const noexcept { return {data_, size()}; }
+#endif
+
+  private:
+    static constexpr size_type alignment = alignof(T) > alignof(size_type) ? alignof(T) : alignof(size_type);
+    static constexpr size_type elements_offset = (sizeof(size_type) + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr bool is_over_aligned = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    // The element count is stored at the start of the block, followed by the elements.
+    [[nodiscard]] auto block() const noexcept -> unsigned char * {
+        return reinterpret_cast<unsigned char *>(data_) - elements_offset;
+    }
+
+    static auto block_size(size_type n) -> size_type {
+        if (n > (static_cast<size_type>(-1) - elements_offset) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return elements_offset + n * sizeof(T);
+    }
+
+    static auto allocate(size_type n) -> unsigned char * {
+        if constexpr (is_over_aligned) {
+            return static_cast<unsigned char *>(::operator new(block_size(n), std::align_val_t{alignment}));
+        } else {
+            return static_cast<unsigned char *>(::operator new(block_size(n)));
+        }
+    }
+
+    static void deallocate(unsigned char *block, size_type n) noexcept {
+        if constexpr (is_over_aligned) {
+            ::operator delete(block, block_size(n), std::align_val_t{alignment});
+        } else {
+            ::operator delete(block, block_size(n));
+        }
+    }
+
+    static void destroy(T *elements, size_type n) noexcept {
+        for (auto i = n; i > 0; --i) {
+            elements[i - 1].~T();
+        }
+    }
+
+    T *data_ = nullptr;
+};
+
+template <class T>
+struct is_trivially_relocatable<unique_array<T>> : std::true_type {};
+
+// Creates a unique_any holding a unique_array<T> of n elements constructed from args. Access the elements with
+// any_cast<unique_array<T> &>().
+template <class T, class... Args>
+auto make_unique_any_array(std::size_t n, const Args &...args) -> unique_any {
+    return unique_any(std::in_place_type<unique_array<T>>, n, args...);
+}
+
+} // namespace mcpp
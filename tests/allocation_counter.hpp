@@ -0,0 +1,80 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+// Replaces the global operator new and delete with versions that count allocations and deallocations. This header
+// defines the replacements, so it must be included by exactly one translation unit of a test executable.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace allocations {
+
+inline int n_news = 0;
+inline int n_deletes = 0;
+
+// Number of allocations that have not been deallocated yet.
+inline auto live() -> int { return n_news - n_deletes; }
+
+inline void count_delete(void *mem) {
+    if (mem != nullptr) {
+        n_deletes += 1;
+    }
+}
+
+} // namespace allocations
+
+auto operator new(std::size_t size) -> void * {
+    allocations::n_news += 1;
+    if (auto *mem = std::malloc(size == 0 ? 1 : size)) {
+        return mem;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new(std::size_t size, std::align_val_t align) -> void * {
+    allocations::n_news += 1;
+    size = size == 0 ? 1 : size;
+#if defined(_WIN32)
+    auto *mem = _aligned_malloc(size, static_cast<std::size_t>(align));
+#else
+    auto *mem = static_cast<void *>(nullptr);
+    if (::posix_memalign(&mem, static_cast<std::size_t>(align), size) != 0) {
+        mem = nullptr;
+    }
+#endif
+    if (mem == nullptr) {
+        throw std::bad_alloc();
+    }
+    return mem;
+}
+
+void operator delete(void *mem) noexcept {
+    allocations::count_delete(mem);
+    std::free(mem);
+}
+
+void operator delete(void *mem, std::size_t /*unused*/) noexcept {
+    allocations::count_delete(mem);
+    std::free(mem);
+}
+
+void operator delete(void *mem, std::align_val_t /*unused*/) noexcept {
+    allocations::count_delete(mem);
+#if defined(_WIN32)
+    _aligned_free(mem);
+#else
+    std::free(mem);
+#endif
+}
+
+void operator delete(void *mem, std::size_t /*unused*/, std::align_val_t align) noexcept {
+    operator delete(mem, align);
+}
@@ -0,0 +1,235 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+// Exact allocation, move, copy and destruction counts of every unique_any operation, for small (inline), large (heap)
+// and immovable (heap) payloads. These are regression tests: an extra allocation or an extra move somewhere, for
+// example in swap(), makes them fail.
+
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include "allocation_counter.hpp"
+#include <any>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <ostream>
+#include <utility>
+
+using namespace mcpp;
+
+namespace {
+
+struct counters {
+    int moves = 0;
+    int copies = 0;
+    int destroys = 0;
+} payload_ops;
+
+// Payload that counts its moves, copies and destructions. It is nothrow-movable, so it is stored inline if it fits.
+template <std::size_t N>
+struct tracked {
+    explicit tracked(int value = 0) noexcept : value(value) {}
+    tracked(std::initializer_list<int> il, int value) noexcept : value(static_cast<int>(il.size()) + value) {}
+    tracked(const tracked &other) noexcept : value(other.value) { payload_ops.copies += 1; }
+    tracked(tracked &&other) noexcept : value(other.value) { payload_ops.moves += 1; }
+    auto operator=(const tracked &rhs) -> tracked & = delete;
+    auto operator=(tracked &&rhs) -> tracked & = delete;
+    ~tracked() { payload_ops.destroys += 1; }
+    int value;
+    char padding[N];
+};
+
+struct immovable {
+    explicit immovable(int value = 0) noexcept : value(value) {}
+    immovable(const immovable &other) = delete;
+    immovable(immovable &&other) = delete;
+    auto operator=(const immovable &rhs) -> immovable & = delete;
+    auto operator=(immovable &&rhs) -> immovable & = delete;
+    ~immovable() { payload_ops.destroys += 1; }
+    int value;
+};
+
+using small = tracked<8>;
+using large = tracked<64>;
+
+static_assert(detail::is_small_object_v<small, unique_any::buffer_size, unique_any::buffer_alignment>);
+static_assert(!detail::is_small_object_v<large, unique_any::buffer_size, unique_any::buffer_alignment>);
+static_assert(!detail::is_small_object_v<immovable, unique_any::buffer_size, unique_any::buffer_alignment>);
+
+struct usage {
+    int allocs;
+    int deallocs;
+    int moves;
+    int copies;
+    int destroys;
+
+    friend auto operator==(const usage &lhs, const usage &rhs) -> bool {
+        return lhs.allocs == rhs.allocs && lhs.deallocs == rhs.deallocs && lhs.moves == rhs.moves &&
+               lhs.copies == rhs.copies && lhs.destroys == rhs.destroys;
+    }
+    friend auto operator<<(std::ostream &os, const usage &u) -> std::ostream & {
+        return os << "{allocs " << u.allocs << ", deallocs " << u.deallocs << ", moves " << u.moves << ", copies "
+                  << u.copies << ", destroys " << u.destroys << "}";
+    }
+};
+
+// What f did, in the order of the fields of usage.
+template <class F>
+auto measure(F &&f) -> usage {
+    auto news = allocations::n_news;
+    auto deletes = allocations::n_deletes;
+    auto ops = payload_ops;
+    std::forward<F>(f)();
+    return {allocations::n_news - news, allocations::n_deletes - deletes, payload_ops.moves - ops.moves,
+            payload_ops.copies - ops.copies, payload_ops.destroys - ops.destroys};
+}
+
+} // namespace
+
+// Measures only the construction of a unique_any from args, not its destruction.
+template <class... Args>
+auto measure_construct(Args &&...args) -> usage {
+    alignas(unique_any) unsigned char storage[sizeof(unique_any)];
+    unique_any *any = nullptr;
+    auto ret = measure([&] { any = ::new (static_cast<void *>(storage)) unique_any(std::forward<Args>(args)...); });
+    any->~unique_any();
+    return ret;
+}
+
+TEST_CASE("default_construct") { CHECK(measure_construct() == usage{0, 0, 0, 0, 0}); }
+
+TEST_CASE("construct_from_value") {
+    auto s = small(1);
+    CHECK(measure_construct(std::move(s)) == usage{0, 0, 1, 0, 0});
+    CHECK(measure_construct(s) == usage{0, 0, 0, 1, 0});
+    auto l = large(1);
+    CHECK(measure_construct(std::move(l)) == usage{1, 0, 1, 0, 0});
+    CHECK(measure_construct(l) == usage{1, 0, 0, 1, 0});
+}
+
+TEST_CASE("construct_in_place") {
+    CHECK(measure_construct(std::in_place_type<small>, 1) == usage{0, 0, 0, 0, 0});
+    CHECK(measure_construct(std::in_place_type<large>, 1) == usage{1, 0, 0, 0, 0});
+    CHECK(measure_construct(std::in_place_type<immovable>, 1) == usage{1, 0, 0, 0, 0});
+    auto il = std::initializer_list<int>{1, 2};
+    CHECK(measure_construct(std::in_place_type<small>, il, 1) == usage{0, 0, 0, 0, 0});
+    CHECK(measure_construct(std::in_place_type<large>, il, 1) == usage{1, 0, 0, 0, 0});
+}
+
+TEST_CASE("construct_from_factory") {
+    CHECK(measure_construct(from_factory, [] { return small(1); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure_construct(from_factory, [] { return large(1); }) == usage{1, 0, 0, 0, 0});
+    CHECK(measure_construct(from_factory, [] { return immovable(1); }) == usage{1, 0, 0, 0, 0});
+}
+
+TEST_CASE("make_unique_any") {
+    auto any = unique_any();
+    // Once into the returned object, once into the temporary of the move assignment and once into any.
+    CHECK(measure([&] { any = make_unique_any<small>(1); }) == usage{0, 0, 2, 0, 2});
+    CHECK(measure([&] { auto tmp = make_unique_any<small>(1); }) == usage{0, 0, 0, 0, 1});
+    CHECK(measure([&] { auto tmp = make_unique_any<large>(1); }) == usage{1, 1, 0, 0, 1});
+    CHECK(measure([&] { auto tmp = make_unique_any<immovable>(1); }) == usage{1, 1, 0, 0, 1});
+    CHECK(measure([&] { auto tmp = make_unique_any<large>({1, 2}, 1); }) == usage{1, 1, 0, 0, 1});
+}
+
+TEST_CASE("move_construct") {
+    auto s = unique_any(std::in_place_type<small>);
+    CHECK(measure([&] { auto moved = std::move(s); }) == usage{0, 0, 1, 0, 2});
+    auto l = unique_any(std::in_place_type<large>);
+    CHECK(measure([&] { auto moved = std::move(l); }) == usage{0, 1, 0, 0, 1});
+    auto i = unique_any(std::in_place_type<immovable>);
+    CHECK(measure([&] { auto moved = std::move(i); }) == usage{0, 1, 0, 0, 1});
+    auto empty = unique_any();
+    CHECK(measure([&] { auto moved = std::move(empty); }) == usage{0, 0, 0, 0, 0});
+}
+
+TEST_CASE("destroy") {
+    CHECK(measure([] { unique_any(std::in_place_type<small>); }) == usage{0, 0, 0, 0, 1});
+    CHECK(measure([] { unique_any(std::in_place_type<large>); }) == usage{1, 1, 0, 0, 1});
+    CHECK(measure([] { unique_any(std::in_place_type<immovable>); }) == usage{1, 1, 0, 0, 1});
+}
+
+TEST_CASE("move_assign") {
+    auto target = unique_any();
+    auto s = unique_any(std::in_place_type<small>);
+    CHECK(measure([&] { target = std::move(s); }) == usage{0, 0, 2, 0, 2});
+    auto s2 = unique_any(std::in_place_type<small>);
+    CHECK(measure([&] { target = std::move(s2); }) == usage{0, 0, 4, 0, 5});
+    auto l = unique_any(std::in_place_type<large>);
+    // Swapping with a non-empty temporary relocates the small payload through a temporary buffer twice.
+    CHECK(measure([&] { target = std::move(l); }) == usage{0, 0, 2, 0, 3});
+    auto l2 = unique_any(std::in_place_type<large>);
+    CHECK(measure([&] { target = std::move(l2); }) == usage{0, 1, 0, 0, 1});
+    auto i = unique_any(std::in_place_type<immovable>);
+    CHECK(measure([&] { target = std::move(i); }) == usage{0, 1, 0, 0, 1});
+    CHECK(measure([&] { target = unique_any(); }) == usage{0, 1, 0, 0, 1});
+}
+
+TEST_CASE("value_assign") {
+    auto target = unique_any();
+    CHECK(measure([&] { target = small(1); }) == usage{0, 0, 2, 0, 2});
+    CHECK(measure([&] { target = small(2); }) == usage{0, 0, 4, 0, 5});
+    CHECK(measure([&] { target = large(1); }) == usage{1, 0, 3, 0, 4});
+    CHECK(measure([&] { target = large(2); }) == usage{1, 1, 1, 0, 2});
+    auto l = large(3);
+    CHECK(measure([&] { target = l; }) == usage{1, 1, 0, 1, 1});
+}
+
+TEST_CASE("swap") {
+    auto a = unique_any(std::in_place_type<small>, 1);
+    auto b = unique_any(std::in_place_type<small>, 2);
+    auto e = unique_any();
+    // Both inline: the payloads are relocated through a temporary buffer.
+    CHECK(measure([&] { a.swap(b); }) == usage{0, 0, 3, 0, 3});
+    CHECK(any_cast<small &>(a).value == 2);
+    CHECK(measure([&] { a.swap(e); }) == usage{0, 0, 1, 0, 1});
+    CHECK(measure([&] { a.swap(e); }) == usage{0, 0, 1, 0, 1});
+    CHECK(measure([&] { e.swap(e); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { a.swap(a); }) == usage{0, 0, 0, 0, 0});
+
+    auto l1 = unique_any(std::in_place_type<large>, 1);
+    auto l2 = unique_any(std::in_place_type<large>, 2);
+    auto i = unique_any(std::in_place_type<immovable>, 3);
+    // Heap payloads only swap pointers.
+    CHECK(measure([&] { l1.swap(l2); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { l1.swap(i); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { l1.swap(e); }) == usage{0, 0, 0, 0, 0});
+    // Mixed: only the inline payload is moved, once if it is in *this, twice if it is in other.
+    CHECK(measure([&] { a.swap(l2); }) == usage{0, 0, 1, 0, 1});
+    CHECK(measure([&] { swap(a, l2); }) == usage{0, 0, 2, 0, 2});
+    CHECK(any_cast<immovable &>(e).value == 3);
+}
+
+TEST_CASE("emplace") {
+    auto any = unique_any();
+    CHECK(measure([&] { any.emplace<small>(1); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { any.emplace<small>(2); }) == usage{0, 0, 0, 0, 1});
+    CHECK(measure([&] { any.emplace<large>(1); }) == usage{1, 0, 0, 0, 1});
+    CHECK(measure([&] { any.emplace<large>(2); }) == usage{1, 1, 0, 0, 1});
+    CHECK(measure([&] { any.emplace<immovable>(1); }) == usage{1, 1, 0, 0, 1});
+    CHECK(measure([&] { any.emplace<small>({1, 2}, 1); }) == usage{0, 1, 0, 0, 1});
+    CHECK(measure([&] { any.emplace<large>({1, 2}, 1); }) == usage{1, 0, 0, 0, 1});
+    CHECK(measure([&] { any.emplace_from([] { return small(1); }); }) == usage{0, 1, 0, 0, 1});
+    CHECK(measure([&] { any.emplace_from([] { return immovable(1); }); }) == usage{1, 0, 0, 0, 1});
+    CHECK(measure([&] { any.reset(); }) == usage{0, 1, 0, 0, 1});
+    CHECK(measure([&] { any.reset(); }) == usage{0, 0, 0, 0, 0});
+}
+
+TEST_CASE("any_cast") {
+    auto s = unique_any(std::in_place_type<small>, 1);
+    auto l = unique_any(std::in_place_type<large>, 2);
+    auto i = unique_any(std::in_place_type<immovable>, 3);
+    const auto &cs = s;
+    CHECK(measure([&] { CHECK(any_cast<small>(&s) != nullptr); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { CHECK(any_cast<large>(&cs) == nullptr); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { CHECK(any_cast<small &>(s).value == 1); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { CHECK(any_cast<const small &>(cs).value == 1); }) == usage{0, 0, 0, 0, 0});
+    CHECK(measure([&] { CHECK(any_cast<immovable &>(i).value == 3); }) == usage{0, 0, 0, 0, 0});
+    // By value: copies from lvalues, moves from rvalues.
+    CHECK(measure([&] { CHECK(any_cast<small>(cs).value == 1); }) == usage{0, 0, 0, 1, 1});
+    CHECK(measure([&] { CHECK(any_cast<large>(l).value == 2); }) == usage{0, 0, 0, 1, 1});
+    CHECK(measure([&] { CHECK(any_cast<large>(std::move(l)).value == 2); }) == usage{0, 0, 1, 0, 1});
+    CHECK(l.has_value());
+    CHECK(measure([&] { CHECK_THROWS_AS(any_cast<large>(s), std::bad_any_cast); }) == usage{0, 0, 0, 0, 0});
+}
@@ -0,0 +1,136 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/any_ring.hpp"
+#include "doctest/doctest.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace mcpp;
+
+namespace {
+
+struct alignas(64) overaligned {
+    int value;
+};
+
+struct immovable {
+    explicit immovable(int &n_alive) : n_alive(&n_alive) { ++n_alive; }
+    immovable(const immovable &other) = delete;
+    immovable(immovable &&other) = delete;
+    auto operator=(const immovable &rhs) -> immovable & = delete;
+    auto operator=(immovable &&rhs) -> immovable & = delete;
+    ~immovable() { --*n_alive; }
+    int *n_alive;
+};
+
+} // namespace
+
+TEST_CASE("fifo") {
+    auto ring = any_ring(1024);
+    CHECK(ring.empty());
+    CHECK(ring.try_push(42));
+    CHECK(ring.try_push(std::string("Foo")));
+    CHECK(ring.try_push(std::array<char, 100>{'x'}));
+    CHECK(ring.try_emplace<overaligned>(overaligned{7}) != nullptr);
+
+    CHECK(ring.try_consume([](any_ref r) { CHECK(any_cast<int>(r) == 42); }));
+    CHECK(ring.try_consume([](any_ref r) { CHECK(any_cast<std::string &>(r) == "Foo"); }));
+    CHECK(ring.try_consume([](any_ref r) { CHECK(any_cast<std::array<char, 100> &>(r)[0] == 'x'); }));
+    CHECK(ring.try_consume([](any_ref r) {
+        auto *p = any_cast<overaligned>(&r);
+        REQUIRE(p != nullptr);
+        CHECK(reinterpret_cast<std::uintptr_t>(p) % 64 == 0);
+        CHECK(p->value == 7);
+    }));
+    CHECK(!ring.try_consume([](any_ref /*unused*/) { FAIL("ring should be empty"); }));
+    CHECK(ring.empty());
+}
+
+TEST_CASE("full_and_wrap_around") {
+    auto ring = any_ring(128);
+    // Each record is 16 bytes of header plus 32 bytes of payload.
+    using payload = std::array<std::uint64_t, 4>;
+    CHECK(ring.try_push(payload{1}));
+    CHECK(ring.try_push(payload{2}));
+    CHECK(!ring.try_push(payload{3}));
+    CHECK(!ring.try_push(std::array<char, 200>{}));
+
+    for (auto i = std::uint64_t{0}; i < 100; ++i) {
+        CHECK(ring.try_consume([&](any_ref r) { CHECK(any_cast<payload &>(r)[0] == i + 1); }));
+        CHECK(ring.try_push(payload{i + 3}));
+    }
+}
+
+TEST_CASE("wrap_around_when_empty") {
+    // At position 64, an 80 byte record does not fit before the end of the buffer, and padding plus record do not fit
+    // into the capacity. The ring is empty though, so the record goes to the start of the buffer.
+    auto ring = any_ring(128);
+    using small = std::array<char, 48>;
+    using large = std::array<char, 64>;
+    CHECK(ring.try_push(small{'a'}));
+    CHECK(ring.try_consume([](any_ref r) { CHECK(any_cast<small &>(r)[0] == 'a'); }));
+    for (auto i = 0; i < 10; ++i) {
+        CHECK(ring.try_push(large{static_cast<char>('0' + i)}));
+        CHECK(!ring.try_push(large{}));
+        CHECK(ring.try_consume([&](any_ref r) { CHECK(any_cast<large &>(r)[0] == '0' + i); }));
+        CHECK(ring.empty());
+        CHECK(ring.try_push(small{'b'}));
+        CHECK(ring.try_consume([](any_ref r) { CHECK(any_cast<small &>(r)[0] == 'b'); }));
+    }
+    CHECK(!ring.try_consume([](any_ref /*unused*/) { FAIL("ring should be empty"); }));
+}
+
+TEST_CASE("destroys_payloads") {
+    auto n_alive = 0;
+    {
+        auto ring = any_ring(256);
+        CHECK(ring.try_emplace<immovable>(n_alive) != nullptr);
+        CHECK(ring.try_emplace<immovable>(n_alive) != nullptr);
+        CHECK(n_alive == 2);
+        CHECK(ring.try_consume([](any_ref r) { CHECK(r.type() == typeid(immovable)); }));
+        CHECK(n_alive == 1);
+    }
+    CHECK(n_alive == 0);
+}
+
+TEST_CASE("spsc") {
+    constexpr auto n_messages = 20000;
+    auto ring = any_ring(4096);
+    auto producer = std::thread([&] {
+        for (auto i = 0; i < n_messages; ++i) {
+            if (i % 3 == 0) {
+                while (!ring.try_push(std::make_unique<int>(i))) {
+                    std::this_thread::yield();
+                }
+            } else {
+                while (!ring.try_push(std::array<int, 20>{i})) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+    auto expected = 0;
+    auto n_mismatches = 0;
+    while (expected < n_messages) {
+        auto consumed = ring.try_consume([&](any_ref r) {
+            if (auto *p = any_cast<std::unique_ptr<int>>(&r)) {
+                n_mismatches += **p != expected ? 1 : 0;
+            } else {
+                n_mismatches += any_cast<std::array<int, 20> &>(r)[0] != expected ? 1 : 0;
+            }
+            ++expected;
+        });
+        if (!consumed) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(n_mismatches == 0);
+    CHECK(ring.empty());
+}
@@ -0,0 +1,130 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/any_serialization.hpp"
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+// Serializable types need a unique type key, so they cannot be in an anonymous namespace.
+namespace serialization_test {
+
+struct point {
+    double x;
+    double y;
+};
+
+struct no_default {
+    explicit no_default(int value) : value(value) {}
+    int value;
+};
+
+struct message {
+    std::string topic;
+    std::unique_ptr<int> priority;
+};
+
+} // namespace serialization_test
+
+using namespace serialization_test;
+
+template <>
+struct mcpp::serialize_traits<message> {
+    static void encode(const message &value, std::vector<std::byte> &out) {
+        auto priority = *value.priority;
+        auto *bytes = reinterpret_cast<const std::byte *>(&priority);
+        out.insert(out.end(), bytes, bytes + sizeof(priority));
+        auto *topic = reinterpret_cast<const std::byte *>(value.topic.data());
+        out.insert(out.end(), topic, topic + value.topic.size());
+    }
+    static auto decode(const std::byte *data, std::size_t size) -> message {
+        auto priority = 0;
+        std::memcpy(&priority, data, sizeof(priority));
+        return message{std::string(reinterpret_cast<const char *>(data) + sizeof(priority), size - sizeof(priority)),
+                       std::make_unique<int>(priority)};
+    }
+};
+
+TEST_CASE("round_trip") {
+    auto registry = serialization_registry();
+    registry.add<point>();
+    registry.add<no_default>();
+    registry.add<message>();
+    registry.add<std::uint64_t>();
+    CHECK(registry.contains<point>());
+    CHECK(!registry.contains<double>());
+
+    auto out = std::vector<std::byte>();
+    registry.serialize(unique_any(point{1.5, 2.5}), out);
+    registry.serialize(unique_any(), out);
+    registry.serialize(unique_any(message{"orders", std::make_unique<int>(7)}), out);
+    registry.serialize(compact_unique_any(no_default(3)), out);
+    registry.serialize(unique_any(std::uint64_t{42}), out);
+
+    auto in = byte_reader{out.data(), out.data() + out.size()};
+    auto p = registry.deserialize(in);
+    CHECK(any_cast<point &>(p).x == 1.5);
+    CHECK(any_cast<point &>(p).y == 2.5);
+    CHECK(!registry.deserialize(in).has_value());
+    auto m = registry.deserialize(in);
+    CHECK(any_cast<message &>(m).topic == "orders");
+    CHECK(*any_cast<message &>(m).priority == 7);
+    auto n = registry.deserialize(in);
+    CHECK(any_cast<no_default &>(n).value == 3);
+    CHECK(any_cast<std::uint64_t>(registry.deserialize(in)) == 42);
+    CHECK(in.remaining() == 0);
+}
+
+TEST_CASE("errors") {
+    auto registry = serialization_registry();
+    registry.add<int>();
+
+    // A rejected payload leaves the output unchanged
+    auto out = std::vector<std::byte>();
+    registry.serialize(unique_any(1), out);
+    auto size = out.size();
+    CHECK_THROWS_WITH_AS(registry.serialize(unique_any(1.0), out),
+                         "mcpp::serialization_registry: payload type is not registered", serialization_error);
+    CHECK(out.size() == size);
+
+    // Truncated in the header, right after the header and in the payload
+    constexpr auto header_size = sizeof(detail::serialized_header);
+    REQUIRE(out.size() == header_size + sizeof(int));
+    for (auto length : {header_size - 1, header_size, out.size() - 1}) {
+        auto truncated = byte_reader{out.data(), out.data() + length};
+        CHECK_THROWS_WITH_AS(static_cast<void>(registry.deserialize(truncated)),
+                             "mcpp::deserialize: unexpected end of input", serialization_error);
+    }
+
+    auto other = serialization_registry();
+    auto in = byte_reader{out.data(), out.data() + out.size()};
+    CHECK_THROWS_WITH_AS(static_cast<void>(other.deserialize(in)),
+                         "mcpp::serialization_registry: payload type is not registered", serialization_error);
+}
+
+TEST_CASE("types_without_unique_key") {
+    // Such types cannot be registered, so they are never found.
+    auto lambda = [] { return 1; };
+    static_assert(!has_unique_type_key_v<decltype(lambda)>);
+    auto registry = serialization_registry();
+    auto out = std::vector<std::byte>();
+    CHECK_THROWS_AS(registry.serialize(unique_any(lambda), out), serialization_error);
+    CHECK(out.empty());
+}
+
+TEST_CASE("global_registry") {
+    register_serializable<point>();
+    auto out = std::vector<std::byte>();
+    serialize(unique_any(point{3, 4}), out);
+    auto in = byte_reader{out.data(), out.data() + out.size()};
+    CHECK(any_cast<point>(deserialize(in)).y == 4);
+}
@@ -0,0 +1,137 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/any_snapshot.hpp"
+#include "doctest/doctest.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+// Snapshot payloads need a unique type key, so they cannot be in an anonymous namespace.
+namespace snapshot_test {
+
+struct point {
+    double x;
+    double y;
+};
+
+struct alignas(64) over_aligned {
+    int value;
+};
+
+} // namespace snapshot_test
+
+using namespace snapshot_test;
+
+namespace {
+
+auto temp_path(const char *name) -> std::string {
+    return std::string(P_tmpdir) + "/mcpp-test-any-snapshot-" + name + ".bin";
+}
+
+} // namespace
+
+TEST_CASE("view") {
+    auto writer = snapshot_writer();
+    writer.push_back(42);
+    writer.push_back(point{1.5, 2.5});
+    writer.push_back('c');
+    REQUIRE(writer.size() == 3);
+
+    auto bytes = writer.bytes();
+    auto view = snapshot_view(bytes.data(), bytes.size());
+    view.validate();
+    REQUIRE(view.size() == 3);
+    auto it = view.begin();
+    auto ref = *it++;
+    CHECK(ref.type_key() == type_key_v<int>);
+    CHECK(any_cast<int>(ref) == 42);
+    CHECK(any_cast<long>(&ref) == nullptr);
+    CHECK_THROWS_AS(any_cast<double>(ref), std::bad_any_cast);
+    ref = *it++;
+    REQUIRE(any_cast<point>(&ref) != nullptr);
+    CHECK(any_cast<point>(&ref)->y == 2.5);
+    ref = *it++;
+    CHECK(any_cast<const char>(&ref) != nullptr);
+    CHECK(any_cast<char>(ref) == 'c');
+    CHECK(it == view.end());
+}
+
+TEST_CASE("empty") {
+    auto writer = snapshot_writer();
+    auto bytes = writer.bytes();
+    auto view = snapshot_view(bytes.data(), bytes.size());
+    view.validate();
+    CHECK(view.empty());
+    CHECK(view.begin() == view.end());
+}
+
+TEST_CASE("invalid") {
+    auto writer = snapshot_writer();
+    writer.push_back(1);
+    writer.push_back(2);
+    auto bytes = writer.bytes();
+    CHECK_THROWS_AS(snapshot_view(bytes.data(), 8), snapshot_error);
+    CHECK_THROWS_AS(snapshot_view(bytes.data(), bytes.size() - 1), snapshot_error);
+
+    auto bad_magic = bytes;
+    bad_magic[0] = std::byte{'x'};
+    CHECK_THROWS_AS(snapshot_view(bad_magic.data(), bad_magic.size()), snapshot_error);
+
+    // Header of the first record claims a payload beyond the end of the data
+    auto bad_record = bytes;
+    auto huge = std::uint32_t{1} << 20;
+    std::memcpy(bad_record.data() + sizeof(detail::snapshot_header) + 8, &huge, sizeof(huge));
+    auto view = snapshot_view(bad_record.data(), bad_record.size());
+    CHECK_THROWS_AS(view.validate(), snapshot_error);
+}
+
+TEST_CASE("mapped") {
+    auto path = temp_path("mapped");
+    auto writer = snapshot_writer();
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 2 == 0) {
+            writer.push_back(i);
+        } else {
+            writer.push_back(over_aligned{i});
+        }
+    }
+    writer.save(path);
+
+    {
+        auto snapshot = mapped_snapshot(path);
+        snapshot.view().validate();
+        REQUIRE(snapshot.size() == 1000);
+        int i = 0;
+        for (auto ref : snapshot) {
+            if (i % 2 == 0) {
+                CHECK(any_cast<int>(ref) == i);
+            } else {
+                auto *ptr = any_cast<over_aligned>(&ref);
+                REQUIRE(ptr != nullptr);
+                CHECK(reinterpret_cast<std::uintptr_t>(ptr) % alignof(over_aligned) == 0);
+                CHECK(ptr->value == i);
+            }
+            ++i;
+        }
+        CHECK(i == 1000);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped errors") {
+    CHECK_THROWS_AS(mapped_snapshot(temp_path("missing")), snapshot_error);
+
+    auto path = temp_path("garbage");
+    auto *file = std::fopen(path.c_str(), "wb");
+    REQUIRE(file != nullptr);
+    std::fputs("not a snapshot, but long enough for a header", file);
+    std::fclose(file);
+    CHECK_THROWS_AS(mapped_snapshot(path), snapshot_error);
+    std::remove(path.c_str());
+}
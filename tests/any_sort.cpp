@@ -0,0 +1,134 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/any_sort.hpp"
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct opaque {
+    int value;
+};
+
+struct keyed {
+    int key;
+    int order;
+    void *padding[4];
+    friend auto operator<(const keyed &lhs, const keyed &rhs) -> bool { return lhs.key < rhs.key; }
+};
+
+auto make_batch() -> std::vector<unique_any> {
+    auto ret = std::vector<unique_any>();
+    for (auto i = 0; i < 20; ++i) {
+        switch (i % 4) {
+            case 0:
+                ret.emplace_back((i * 7) % 20);
+                break;
+            case 1:
+                ret.emplace_back(std::to_string((i * 3) % 20));
+                break;
+            case 2:
+                ret.emplace_back(keyed{i % 3, i, {}});
+                break;
+            default:
+                ret.emplace_back();
+                break;
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
+template <>
+struct mcpp::is_less_than_comparable<keyed> : std::true_type {};
+
+static_assert(is_less_than_comparable_v<int>);
+static_assert(is_less_than_comparable_v<std::string>);
+static_assert(is_less_than_comparable_v<keyed>);
+static_assert(!is_less_than_comparable_v<opaque>);
+static_assert(!is_less_than_comparable_v<std::vector<std::string>>);
+static_assert(!is_less_than_comparable_v<int *>);
+
+TEST_CASE("three_way_compare") {
+    CHECK(three_way_compare(unique_any(), unique_any()) == 0);
+    CHECK(three_way_compare(unique_any(), unique_any(1)) < 0);
+    CHECK(three_way_compare(unique_any(1), unique_any()) > 0);
+    CHECK(three_way_compare(unique_any(1), unique_any(2)) < 0);
+    CHECK(three_way_compare(unique_any(2), unique_any(1)) > 0);
+    CHECK(three_way_compare(unique_any(2), unique_any(2)) == 0);
+
+    // Types are ordered by their keys, regardless of the values
+    auto int_first = type_key_v<int> < type_key_v<std::string>;
+    CHECK((three_way_compare(unique_any(100), unique_any(std::string())) < 0) == int_first);
+    CHECK((three_way_compare(unique_any(std::string()), unique_any(100)) < 0) != int_first);
+
+    // Payloads of different types are ordered even without operator<
+    CHECK(three_way_compare(unique_any(opaque{1}), unique_any(1)) != 0);
+    CHECK_THROWS_AS(static_cast<void>(three_way_compare(unique_any(opaque{1}), unique_any(opaque{2}))),
+                    std::logic_error);
+
+    // Storing payloads whose operator< does not compile still works
+    auto variant = unique_any(std::variant<int, opaque>(opaque{1}));
+    CHECK_THROWS_AS(static_cast<void>(three_way_compare(variant, unique_any(std::variant<int, opaque>(1)))),
+                    std::logic_error);
+}
+
+TEST_CASE("ordered_container") {
+    auto map = std::map<unique_any, int, any_less>();
+    map.emplace(2, 0);
+    map.emplace(std::string("b"), 1);
+    map.emplace(1, 2);
+    map.emplace(std::string("a"), 3);
+    CHECK(map.size() == 4);
+    CHECK(map.at(unique_any(1)) == 2);
+    CHECK(map.at(unique_any(std::string("b"))) == 1);
+    CHECK(map.count(unique_any(1L)) == 0);
+}
+
+TEST_CASE("sort_any") {
+    auto batch = make_batch();
+    sort_any(batch.begin(), batch.end());
+    CHECK(std::is_sorted(batch.begin(), batch.end(), any_less()));
+
+    // Same-type runs are contiguous, empty objects first
+    auto n_runs = 1;
+    for (auto i = std::size_t{1}; i < batch.size(); ++i) {
+        n_runs += batch[i].type_key() != batch[i - 1].type_key() ? 1 : 0;
+    }
+    CHECK(n_runs == 4);
+    CHECK(!batch.front().has_value());
+}
+
+TEST_CASE("stable_sort_any") {
+    auto batch = make_batch();
+    stable_sort_any(batch.begin(), batch.end());
+    CHECK(std::is_sorted(batch.begin(), batch.end(), any_less()));
+
+    auto prev = static_cast<const keyed *>(nullptr);
+    for (auto &any : batch) {
+        if (auto *value = any_cast<keyed>(&any)) {
+            if (prev != nullptr && prev->key == value->key) {
+                CHECK(prev->order < value->order);
+            }
+            prev = value;
+        }
+    }
+
+    auto opaques = std::vector<unique_any>();
+    opaques.emplace_back(opaque{1});
+    opaques.emplace_back(1);
+    opaques.emplace_back(opaque{2});
+    CHECK_THROWS_AS(stable_sort_any(opaques.begin(), opaques.end()), std::logic_error);
+}
@@ -0,0 +1,178 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/async_logger.hpp"
+#include "doctest/doctest.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct point {
+    int x;
+    int y;
+};
+
+auto operator<<(std::ostream &os, const point &p) -> std::ostream & { return os << '(' << p.x << ", " << p.y << ')'; }
+
+struct collector {
+    void operator()(const log_message &message) {
+        auto lock = std::lock_guard(mutex);
+        lines.emplace_back(message.text);
+        levels.push_back(message.level);
+    }
+    std::mutex mutex;
+    std::vector<std::string> lines;
+    std::vector<log_level> levels;
+};
+
+} // namespace
+
+template <>
+struct mcpp::log_formatter<std::unique_ptr<int>> {
+    static void format(std::string &out, const std::unique_ptr<int> &value) {
+        out += value ? "ptr(" + std::to_string(*value) + ")" : "null";
+    }
+};
+
+TEST_CASE("format") {
+    auto out = collector();
+    {
+        auto logger = async_logger(std::ref(out));
+        CHECK(logger.log(log_level::info, "plain"));
+        CHECK(logger.log(log_level::warning, "{} + {} = {}", 1, 2.5, 3.5f));
+        CHECK(logger.log(log_level::info, "{} {} {} {}", true, 'c', std::string("string"), "literal"));
+        CHECK(logger.log(log_level::debug, "point {}", point{1, 2}));
+        CHECK(logger.log(log_level::error, "missing {} {}", 1));
+        CHECK(logger.log(log_level::info, "extra", 1, std::string_view("two")));
+        CHECK(logger.log(log_level::info, "{} {} {}", 0.1, 123456789.0, 1.0 / 3));
+        logger.flush();
+        CHECK(logger.stats().formatted == 7);
+        CHECK(logger.stats().dropped == 0);
+    }
+    REQUIRE(out.lines.size() == 7);
+    CHECK(out.lines[0] == "plain");
+    CHECK(out.lines[1] == "1 + 2.5 = 3.5");
+    CHECK(out.lines[2] == "true c string literal");
+    CHECK(out.lines[3] == "point (1, 2)");
+    CHECK(out.lines[4] == "missing 1 {}");
+    CHECK(out.lines[5] == "extra 1 two");
+    // Floating-point values are formatted so that they read back as the same value
+    CHECK(out.lines[6].rfind("0.1 123456789 ", 0) == 0);
+    CHECK(std::stod(out.lines[6].substr(out.lines[6].rfind(' ') + 1)) == 1.0 / 3);
+    CHECK(out.levels[1] == log_level::warning);
+    CHECK(to_string(out.levels[4]) == "error");
+}
+
+TEST_CASE("move_only_and_captured_by_value") {
+    auto out = collector();
+    auto logger = async_logger(std::ref(out));
+    auto text = std::string("a string that is too long for the small string optimization");
+    logger.log(log_level::info, "{} {}", std::make_unique<int>(42), text);
+    auto buffer = std::string("temporary");
+    logger.log(log_level::info, "{}", buffer.c_str());
+    buffer = "overwritten";
+    text.clear();
+    logger.flush();
+    REQUIRE(out.lines.size() == 2);
+    CHECK(out.lines[0] == "ptr(42) a string that is too long for the small string optimization");
+    CHECK(out.lines[1] == "temporary");
+}
+
+TEST_CASE("flush_after_idle") {
+    auto out = collector();
+    auto logger = async_logger(std::ref(out));
+    // Let the background thread back off to its longest wait
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(logger.log(log_level::info, "late"));
+    logger.flush();
+    REQUIRE(out.lines.size() == 1);
+    CHECK(out.lines[0] == "late");
+}
+
+TEST_CASE("sequential_loggers") {
+    // Each logger gets a fresh ring in this thread, even if it reuses the address of a destroyed one.
+    for (int i = 0; i < 100; ++i) {
+        auto out = collector();
+        auto logger = async_logger(std::ref(out), 1024);
+        CHECK(logger.log(log_level::info, "{}", i));
+        logger.flush();
+        CHECK(logger.stats().formatted == 1);
+        REQUIRE(out.lines.size() == 1);
+        CHECK(out.lines[0] == std::to_string(i));
+    }
+}
+
+TEST_CASE("small_arguments_are_inline") {
+    constexpr auto size = detail::log_value::buffer_size;
+    constexpr auto align = detail::log_value::buffer_alignment;
+    CHECK(detail::is_small_object_v<std::string, size, align>);
+    CHECK(detail::is_small_object_v<double, size, align>);
+    CHECK(detail::is_small_object_v<std::unique_ptr<int>, size, align>);
+}
+
+TEST_CASE("full_ring_drops") {
+    auto out = collector();
+    auto blocked = std::mutex();
+    auto logger = async_logger(
+        [&](const log_message &message) {
+            auto lock = std::lock_guard(blocked);
+            out(message);
+        },
+        1024);
+    auto n_logged = std::size_t{0};
+    {
+        // The sink blocks, so the ring fills up.
+        auto lock = std::lock_guard(blocked);
+        for (int i = 0; i < 1000; ++i) {
+            n_logged += logger.log(log_level::info, "{}", i) ? 1 : 0;
+        }
+    }
+    logger.flush();
+    CHECK(n_logged < 1000);
+    CHECK(logger.stats().dropped == 1000 - n_logged);
+    CHECK(logger.stats().formatted == n_logged);
+    CHECK(out.lines.size() == n_logged);
+}
+
+TEST_CASE("threads") {
+    auto out = collector();
+    constexpr int n_threads = 4;
+    constexpr int n = 2000;
+    {
+        auto logger = async_logger(std::ref(out));
+        auto threads = std::vector<std::thread>();
+        for (int t = 0; t < n_threads; ++t) {
+            threads.emplace_back([&logger, t] {
+                for (int i = 0; i < n; ++i) {
+                    while (!logger.log(log_level::info, "{} {}", t, i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+    REQUIRE(out.lines.size() == n_threads * n);
+    // Records of each thread arrive in order.
+    int next[n_threads] = {};
+    bool in_order = true;
+    for (const auto &line : out.lines) {
+        auto t = std::stoi(line);
+        auto i = std::stoi(line.substr(line.find(' ') + 1));
+        in_order = in_order && i == next[t];
+        next[t] = i + 1;
+    }
+    CHECK(in_order);
+}
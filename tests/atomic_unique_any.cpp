@@ -0,0 +1,71 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/atomic_unique_any.hpp"
+#include "doctest/doctest.h"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mcpp;
+
+TEST_CASE("store_exchange_take") {
+    auto slot = atomic_unique_any();
+    CHECK(!slot.has_value());
+
+    slot.store(std::string("Foo"));
+    CHECK(slot.has_value());
+
+    auto old = slot.exchange(std::make_unique<int>(42));
+    CHECK(any_cast<std::string &>(old) == "Foo");
+
+    auto taken = slot.take();
+    CHECK(!slot.has_value());
+    CHECK(*any_cast<std::unique_ptr<int> &>(taken) == 42);
+
+    CHECK(!slot.take().has_value());
+}
+
+TEST_CASE("try_store") {
+    auto slot = atomic_unique_any();
+    auto first = unique_any(1);
+    CHECK(slot.try_store(first));
+    CHECK(!first.has_value());
+
+    auto second = unique_any(2);
+    CHECK(!slot.try_store(second));
+    CHECK(any_cast<int>(second) == 2);
+    CHECK(any_cast<int>(slot.take()) == 1);
+}
+
+TEST_CASE("concurrent_exchange") {
+    constexpr auto n_threads = 4;
+    constexpr auto n_iterations = 10000;
+    auto slot = atomic_unique_any(std::make_unique<int>(n_threads));
+
+    // Every thread keeps swapping its token with the one in the slot. No token may be lost or duplicated.
+    auto threads = std::vector<std::thread>();
+    auto tokens = std::vector<unique_any>(n_threads);
+    for (auto t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            auto token = unique_any(std::make_unique<int>(t));
+            for (auto i = 0; i < n_iterations; ++i) {
+                token = slot.exchange(std::move(token));
+            }
+            tokens[t] = std::move(token);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    tokens.push_back(slot.take());
+
+    auto seen = std::vector<bool>(n_threads + 1);
+    for (auto &token : tokens) {
+        auto value = *any_cast<std::unique_ptr<int> &>(token);
+        CHECK(!seen[value]);
+        seen[value] = true;
+    }
+}
@@ -0,0 +1,115 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/deferred_reclaimer.hpp"
+#include "doctest/doctest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct large {
+    explicit large(std::atomic<std::thread::id> &destroyed_on) : destroyed_on(&destroyed_on) {}
+    large(const large &other) = delete;
+    large(large &&other) = delete;
+    auto operator=(const large &rhs) -> large & = delete;
+    auto operator=(large &&rhs) -> large & = delete;
+    ~large() { *destroyed_on = std::this_thread::get_id(); }
+    std::atomic<std::thread::id> *destroyed_on;
+    void *padding[4] = {};
+};
+
+struct blocking {
+    explicit blocking(std::atomic<int> &state) : state(&state) {}
+    blocking(blocking &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+    blocking(const blocking &other) = delete;
+    auto operator=(const blocking &rhs) -> blocking & = delete;
+    auto operator=(blocking &&rhs) -> blocking & = delete;
+    ~blocking() {
+        if (state != nullptr) {
+            *state = 1;
+            while (*state != 2) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    std::atomic<int> *state;
+};
+
+} // namespace
+
+TEST_CASE("destroys_on_background_thread") {
+    auto state = std::atomic<int>(0);
+    auto destroyed_on = std::atomic<std::thread::id>();
+    auto reclaimer = deferred_reclaimer(16);
+    auto any = unique_any(std::in_place_type<large>, destroyed_on);
+
+    // Keep the background thread busy with another payload, so that the large one stays pending.
+    CHECK(reclaimer.defer_destroy(unique_any(blocking(state))));
+    while (state != 1) {
+        std::this_thread::yield();
+    }
+    CHECK(reclaimer.deferred_reset(any));
+    CHECK(!any.has_value());
+    CHECK(destroyed_on.load() == std::thread::id());
+    CHECK(reclaimer.stats().pending == 1);
+
+    state = 2;
+    reclaimer.drain();
+    CHECK(destroyed_on.load() != std::thread::id());
+    CHECK(destroyed_on.load() != std::this_thread::get_id());
+
+    auto stats = reclaimer.stats();
+    CHECK(stats.enqueued == 2);
+    CHECK(stats.destroyed == 2);
+    CHECK(stats.overflowed == 0);
+    CHECK(stats.pending == 0);
+    CHECK(stats.high_water == 1);
+}
+
+TEST_CASE("overflow_destroys_inline") {
+    auto state = std::atomic<int>(0);
+    auto destroyed_on = std::atomic<std::thread::id>();
+    auto reclaimer = deferred_reclaimer(1);
+
+    // Keep the background thread busy with the first payload.
+    CHECK(reclaimer.defer_destroy(unique_any(blocking(state))));
+    while (state != 1) {
+        std::this_thread::yield();
+    }
+    CHECK(reclaimer.defer_destroy(unique_any(std::in_place_type<large>, destroyed_on)));
+    CHECK(!reclaimer.defer_destroy(unique_any(std::in_place_type<large>, destroyed_on)));
+    CHECK(destroyed_on.load() == std::this_thread::get_id());
+
+    state = 2;
+    reclaimer.drain();
+    auto stats = reclaimer.stats();
+    CHECK(stats.enqueued == 2);
+    CHECK(stats.destroyed == 2);
+    CHECK(stats.overflowed == 1);
+}
+
+TEST_CASE("destructor_drains") {
+    auto destroyed = std::atomic<int>(0);
+    struct counted {
+        explicit counted(std::atomic<int> &destroyed) : destroyed(&destroyed) {}
+        counted(const counted &other) = delete;
+        counted(counted &&other) = delete;
+        auto operator=(const counted &rhs) -> counted & = delete;
+        auto operator=(counted &&rhs) -> counted & = delete;
+        ~counted() { *destroyed += 1; }
+        std::atomic<int> *destroyed;
+    };
+    {
+        auto reclaimer = deferred_reclaimer(4, deferred_reclaimer::overflow_policy::block);
+        for (auto i = 0; i < 100; ++i) {
+            reclaimer.defer_destroy(unique_any(std::in_place_type<counted>, destroyed));
+        }
+        CHECK(reclaimer.stats().high_water <= 4);
+    }
+    CHECK(destroyed == 100);
+}
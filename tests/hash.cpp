@@ -0,0 +1,100 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct opaque {
+    int value;
+};
+
+struct point {
+    int x;
+    int y;
+    friend auto operator==(const point &lhs, const point &rhs) -> bool { return lhs.x == rhs.x && lhs.y == rhs.y; }
+};
+
+} // namespace
+
+template <>
+struct mcpp::is_equality_comparable<point> : std::true_type {};
+template <>
+struct mcpp::is_equality_comparable<std::vector<int>> : std::true_type {};
+
+static_assert(is_equality_comparable_v<int>);
+static_assert(is_equality_comparable_v<std::string>);
+static_assert(is_equality_comparable_v<point>);
+static_assert(!is_equality_comparable_v<opaque>);
+static_assert(!is_equality_comparable_v<std::vector<opaque>>);
+static_assert(!is_equality_comparable_v<std::pair<int, std::string>>);
+
+TEST_CASE("hash") {
+    CHECK(unique_any().hash() == 0);
+    CHECK(unique_any(42).hash() == std::hash<int>{}(42));
+    CHECK(unique_any(std::string(100, 'x')).hash() == std::hash<std::string>{}(std::string(100, 'x')));
+    CHECK_THROWS_AS(static_cast<void>(unique_any(opaque{1}).hash()), std::logic_error);
+    // Opted in, but without std::hash
+    CHECK_THROWS_AS(static_cast<void>(unique_any(point{1, 2}).hash()), std::logic_error);
+}
+
+TEST_CASE("equality") {
+    CHECK(unique_any() == unique_any());
+    CHECK(unique_any() != unique_any(1));
+    CHECK(unique_any(1) == unique_any(1));
+    CHECK(unique_any(1) != unique_any(2));
+    CHECK(unique_any(1) != unique_any(1L));
+    CHECK(unique_any(point{1, 2}) == unique_any(point{1, 2}));
+    CHECK(compact_unique_any(std::string(100, 'x')) == compact_unique_any(std::string(100, 'x')));
+
+    // Payloads of different types are unequal without looking at the payloads
+    CHECK(unique_any(opaque{1}) != unique_any(1));
+    CHECK_THROWS_AS(static_cast<void>(unique_any(opaque{1}) == unique_any(opaque{1})), std::logic_error);
+
+    // Storing payloads whose operator== does not compile still works
+    auto any = unique_any(std::vector<opaque>(3));
+    CHECK(any.has_value());
+    auto variant = unique_any(std::variant<int, opaque>(opaque{1}));
+    CHECK_THROWS_AS(static_cast<void>(variant == unique_any(std::variant<int, opaque>(1))), std::logic_error);
+
+    // Opted in container
+    CHECK(unique_any(std::vector<int>{1, 2}) == unique_any(std::vector<int>{1, 2}));
+    CHECK(unique_any(std::vector<int>{1, 2}) != std::vector<int>{1});
+
+    CHECK(unique_any(1) == 1);
+    CHECK(2 != unique_any(1));
+    CHECK(unique_any(1L) != 1);
+    CHECK(unique_any() != 1);
+    CHECK(unique_any(std::string("foo")) == std::string("foo"));
+}
+
+TEST_CASE("unordered_set") {
+    auto set = std::unordered_set<unique_any, std::hash<unique_any>, std::equal_to<>>();
+    set.emplace(1);
+    set.emplace(std::string("foo"));
+    set.emplace(true);
+    CHECK(set.size() == 3);
+    CHECK(!set.emplace(std::string("foo")).second);
+    CHECK(set.count(unique_any(1)) == 1);
+    CHECK(set.count(unique_any(1L)) == 0);
+
+#if defined(__cpp_lib_generic_unordered_lookup)
+    // Heterogeneous lookup, without constructing a unique_any
+    CHECK(set.find(1) != set.end());
+    CHECK(set.find(2) == set.end());
+    CHECK(set.find(std::string("foo")) != set.end());
+    CHECK(set.contains(true));
+    CHECK(!set.contains(1L));
+#endif
+}
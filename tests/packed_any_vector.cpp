@@ -0,0 +1,112 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/packed_any_vector.hpp"
+#include "doctest/doctest.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace mcpp;
+
+namespace {
+
+struct large {
+    int value;
+    char padding[252];
+};
+
+struct alignas(64) over_aligned {
+    int value;
+};
+
+struct counted {
+    explicit counted(int &n_destroyed) : n_destroyed(&n_destroyed) {}
+    counted(const counted &other) = delete;
+    auto operator=(const counted &rhs) -> counted & = delete;
+    ~counted() { *n_destroyed += 1; }
+    int *n_destroyed;
+};
+
+struct throwing {
+    explicit throwing(int /*unused*/) { throw std::runtime_error("throwing"); }
+};
+
+} // namespace
+
+TEST_CASE("memory_order") {
+    auto vec = packed_any_vector(4096);
+    for (auto i = 0; i < 100; ++i) {
+        if (i % 2 == 0) {
+            vec.push_back(large{i, {}});
+        } else {
+            vec.emplace_back<std::string>(std::to_string(i));
+        }
+    }
+    CHECK(vec.size() == 100);
+    CHECK(vec.chunk_count() > 1);
+
+    auto i = 0;
+    auto prev = static_cast<const void *>(nullptr);
+    auto n_ordered = 0;
+    for (auto ref : vec) {
+        const void *ptr = nullptr;
+        if (i % 2 == 0) {
+            auto *value = any_cast<large>(&ref);
+            REQUIRE(value != nullptr);
+            CHECK(value->value == i);
+            ptr = value;
+        } else {
+            auto *value = any_cast<std::string>(&ref);
+            REQUIRE(value != nullptr);
+            CHECK(*value == std::to_string(i));
+            ptr = value;
+        }
+        n_ordered += prev < ptr ? 1 : 0;
+        prev = ptr;
+        ++i;
+    }
+    // Addresses only go down when a new chunk starts
+    CHECK(n_ordered >= 100 - static_cast<int>(vec.chunk_count()));
+
+    CHECK(any_cast<std::string>(vec[1]) == "1");
+    CHECK(vec.end() - vec.begin() == 100);
+    CHECK_THROWS_AS(static_cast<void>(vec.at(100)), std::out_of_range);
+}
+
+TEST_CASE("alignment_and_oversized") {
+    auto vec = packed_any_vector(256);
+    vec.push_back('x');
+    auto &aligned = vec.emplace_back<over_aligned>(over_aligned{3});
+    CHECK(reinterpret_cast<std::uintptr_t>(&aligned) % 64 == 0);
+    auto &big = vec.emplace_back<large>();
+    auto &bigger = vec.emplace_back<std::pair<large, large>>();
+    CHECK(static_cast<void *>(&bigger) != static_cast<void *>(&big));
+}
+
+TEST_CASE("destruction") {
+    auto n_destroyed = 0;
+    {
+        auto vec = packed_any_vector(128);
+        for (auto i = 0; i < 10; ++i) {
+            vec.emplace_back<counted>(n_destroyed);
+        }
+        auto moved = std::move(vec);
+        CHECK(moved.size() == 10);
+        CHECK(n_destroyed == 0);
+        moved.clear();
+        CHECK(n_destroyed == 10);
+        CHECK(moved.chunk_count() == 0);
+        moved.emplace_back<counted>(n_destroyed);
+    }
+    CHECK(n_destroyed == 11);
+
+    auto vec = packed_any_vector();
+    vec.push_back(1);
+    CHECK_THROWS_AS(vec.emplace_back<throwing>(1), std::runtime_error);
+    CHECK(vec.size() == 1);
+    vec.push_back(2);
+    CHECK(any_cast<int>(vec[1]) == 2);
+}
@@ -0,0 +1,68 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/prefetch_ahead.hpp"
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include <string>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct large {
+    int value;
+    void *a[4];
+};
+
+struct counted {
+    void prefetch() const { *n_prefetched += 1; }
+    int *n_prefetched;
+};
+
+} // namespace
+
+TEST_CASE("visits_all_elements_in_order") {
+    for (auto distance : {0, 1, 4, 100}) {
+        auto anys = std::vector<unique_any>();
+        for (auto i = 0; i < 10; ++i) {
+            if (i % 2 == 0) {
+                anys.emplace_back(large{i, {}});
+            } else {
+                anys.emplace_back(i);
+            }
+        }
+        auto expected = 0;
+        for (auto &any : prefetch_ahead(anys, distance)) {
+            if (auto *ptr = any_cast<large>(&any)) {
+                CHECK(ptr->value == expected);
+            } else {
+                CHECK(any_cast<int>(any) == expected);
+            }
+            ++expected;
+        }
+        CHECK(expected == 10);
+    }
+}
+
+TEST_CASE("empty_range") {
+    auto anys = std::vector<unique_any>();
+    for ([[maybe_unused]] auto &any : prefetch_ahead(anys)) {
+        FAIL("unexpected element");
+    }
+}
+
+TEST_CASE("prefetches_every_element_once") {
+    for (auto distance : {0, 1, 4, 9, 10, 100}) {
+        auto n_prefetched = std::vector<int>(10);
+        auto elements = std::vector<counted>();
+        for (auto &n : n_prefetched) {
+            elements.push_back(counted{&n});
+        }
+        for ([[maybe_unused]] auto &element : prefetch_ahead(elements, distance)) {
+        }
+        CHECK(n_prefetched == std::vector<int>(10, 1));
+    }
+}
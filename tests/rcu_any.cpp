@@ -0,0 +1,91 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/rcu_any.hpp"
+#include "doctest/doctest.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mcpp;
+
+namespace {
+
+struct tracked {
+    explicit tracked(int value, int &n_alive) : value(value), n_alive(&n_alive) { ++n_alive; }
+    tracked(const tracked &other) = delete;
+    tracked(tracked &&other) = delete;
+    auto operator=(const tracked &rhs) -> tracked & = delete;
+    auto operator=(tracked &&rhs) -> tracked & = delete;
+    ~tracked() { --*n_alive; }
+    int value;
+    int *n_alive;
+};
+
+struct pair {
+    long long a;
+    long long b;
+};
+
+} // namespace
+
+TEST_CASE("publish_and_read") {
+    auto cfg = rcu_any();
+    auto reader = cfg.make_reader();
+    CHECK(!reader.read()->has_value());
+
+    cfg.publish(std::string("Foo"));
+    CHECK(any_cast<const std::string &>(*reader.read()) == "Foo");
+
+    cfg.publish(std::string("Bar"));
+    CHECK(any_cast<const std::string &>(*reader.read()) == "Bar");
+    CHECK(cfg.collect() == 0);
+}
+
+TEST_CASE("deferred_reclamation") {
+    auto n_alive = 0;
+    auto cfg = rcu_any(unique_any(std::in_place_type<tracked>, 1, n_alive));
+    auto reader = cfg.make_reader();
+    {
+        auto snap = reader.read();
+        cfg.publish(unique_any(std::in_place_type<tracked>, 2, n_alive));
+        // The first payload is still visible through the snapshot.
+        CHECK(n_alive == 2);
+        CHECK(any_cast<const tracked &>(*snap).value == 1);
+        CHECK(cfg.collect() == 1);
+    }
+    CHECK(cfg.collect() == 0);
+    CHECK(n_alive == 1);
+    CHECK(any_cast<const tracked &>(*reader.read()).value == 2);
+}
+
+TEST_CASE("concurrent_readers") {
+    constexpr auto n_readers = 3;
+    constexpr auto n_publishes = 2000;
+    auto cfg = rcu_any(pair{0, 0});
+    auto done = std::atomic<bool>(false);
+    auto n_torn = std::atomic<int>(0);
+
+    auto threads = std::vector<std::thread>();
+    for (auto t = 0; t < n_readers; ++t) {
+        threads.emplace_back([&, reader = cfg.make_reader()]() mutable {
+            while (!done.load()) {
+                auto snap = reader.read();
+                const auto &value = any_cast<const pair &>(*snap);
+                if (value.a != value.b) {
+                    ++n_torn;
+                }
+            }
+        });
+    }
+    for (auto i = 1; i <= n_publishes; ++i) {
+        cfg.publish(pair{i, i});
+    }
+    done = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK(n_torn == 0);
+}
@@ -0,0 +1,219 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/shm_any_queue.hpp"
+#include "doctest/doctest.h"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace mcpp;
+
+// Payload types need a unique type key, so they cannot be in an anonymous namespace.
+namespace shm_test {
+
+struct alignas(64) overaligned {
+    int value;
+};
+
+struct message {
+    std::uint32_t producer;
+    std::uint32_t sequence;
+};
+
+} // namespace shm_test
+
+using namespace shm_test;
+
+namespace {
+
+// Unique per test and process. Kept short, since macOS limits shared memory names to 31 characters.
+auto segment_name() -> std::string {
+    static auto n = 0;
+    return "/mcq" + std::to_string(::getpid()) + "-" + std::to_string(n++);
+}
+
+// Runs f in a forked child process, which exits with a non-zero status if f throws.
+template <class F>
+auto fork_child(F f) -> pid_t {
+    auto pid = ::fork();
+    if (pid == 0) {
+        try {
+            f();
+        } catch (...) {
+            ::_exit(1);
+        }
+        ::_exit(0);
+    }
+    return pid;
+}
+
+auto wait_child(pid_t pid) -> bool {
+    int status = 0;
+    return ::waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+TEST_CASE("fifo") {
+    auto name = segment_name();
+    auto queue = shm_any_queue::create(name, 1024);
+    shm_any_queue::remove(name);
+    queue.accept<int>();
+    queue.accept<std::array<char, 100>>();
+    queue.accept<overaligned>();
+    CHECK(queue.empty());
+    CHECK(queue.try_push(42));
+    CHECK(queue.try_push(std::array<char, 100>{'x'}));
+    CHECK(queue.try_push(overaligned{7}));
+
+    CHECK(queue.try_consume([](any_ref r) { CHECK(any_cast<int>(r) == 42); }));
+    auto any = queue.try_pop();
+    REQUIRE(any.has_value());
+    CHECK(any_cast<std::array<char, 100> &>(*any)[0] == 'x');
+    CHECK(queue.try_consume([](any_ref r) {
+        auto *p = any_cast<overaligned>(&r);
+        REQUIRE(p != nullptr);
+        CHECK(reinterpret_cast<std::uintptr_t>(p) % 64 == 0);
+        CHECK(p->value == 7);
+    }));
+    CHECK(!queue.try_consume([](any_ref /*unused*/) { FAIL("queue should be empty"); }));
+    CHECK(!queue.try_pop().has_value());
+    CHECK(queue.empty());
+}
+
+TEST_CASE("full_and_wrap_around") {
+    auto name = segment_name();
+    auto queue = shm_any_queue::create(name, 128);
+    shm_any_queue::remove(name);
+    queue.accept<std::uint64_t>();
+    using payload = std::array<std::uint64_t, 4>;
+    queue.accept<payload>();
+    // Each record is 16 bytes of header plus 32 bytes of payload.
+    CHECK(queue.try_push(payload{1}));
+    CHECK(queue.try_push(payload{2}));
+    CHECK(!queue.try_push(payload{3}));
+    CHECK(queue.try_consume([](any_ref r) { CHECK(any_cast<payload &>(r)[0] == 1); }));
+    // Only 32 bytes left before the end of the buffer, so this one wraps around.
+    CHECK(queue.try_push(payload{3}));
+    CHECK(queue.try_consume([](any_ref r) { CHECK(any_cast<payload &>(r)[0] == 2); }));
+    CHECK(queue.try_consume([](any_ref r) { CHECK(any_cast<payload &>(r)[0] == 3); }));
+    for (std::uint64_t i = 0; i < 100; ++i) {
+        CHECK(queue.try_push(i));
+        CHECK(queue.try_consume([&](any_ref r) { CHECK(any_cast<std::uint64_t>(r) == i); }));
+    }
+    CHECK(queue.empty());
+}
+
+TEST_CASE("not_accepted") {
+    auto name = segment_name();
+    auto queue = shm_any_queue::create(name, 256);
+    shm_any_queue::remove(name);
+    queue.accept<int>();
+    CHECK(queue.try_push(1.5));
+    CHECK(queue.try_push(2));
+    CHECK_THROWS_AS(queue.try_pop(), std::logic_error);
+    auto any = queue.try_pop();
+    REQUIRE(any.has_value());
+    CHECK(any_cast<int>(*any) == 2);
+}
+
+TEST_CASE("open") {
+    auto name = segment_name();
+    CHECK_THROWS_AS(shm_any_queue::open(name), std::runtime_error);
+    auto queue = shm_any_queue::create(name, 256);
+    CHECK_THROWS_AS(shm_any_queue::create(name, 256), std::runtime_error);
+    auto other = shm_any_queue::open(name);
+    shm_any_queue::remove(name);
+    CHECK(other.capacity() == 256);
+    other.accept<int>();
+    CHECK(queue.try_push(5));
+    CHECK(other.try_consume([](any_ref r) { CHECK(any_cast<int>(r) == 5); }));
+    CHECK(queue.empty());
+}
+
+TEST_CASE("two_processes") {
+    auto name = segment_name();
+    auto queue = shm_any_queue::create(name, 4096);
+    queue.accept<message>();
+    constexpr std::uint32_t n = 20000;
+
+    auto child = fork_child([&] {
+        auto producer = shm_any_queue::open(name);
+        for (std::uint32_t i = 0; i < n; ++i) {
+            while (!producer.try_push(message{0, i})) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    REQUIRE(child > 0);
+
+    std::uint32_t expected = 0;
+    while (expected < n) {
+        auto consumed = queue.try_consume([&](any_ref r) {
+            auto m = any_cast<message>(r);
+            CHECK(m.sequence == expected);
+            ++expected;
+        });
+        if (!consumed) {
+            std::this_thread::yield();
+        }
+    }
+    CHECK(wait_child(child));
+    shm_any_queue::remove(name);
+    CHECK(queue.empty());
+}
+
+TEST_CASE("multiple_producer_processes") {
+    auto name = segment_name();
+    auto queue = shm_any_queue::create(name, 4096);
+    queue.accept<message>();
+    queue.accept<std::uint64_t>();
+    constexpr std::uint32_t n_producers = 3;
+    constexpr std::uint32_t n = 10000;
+
+    pid_t children[n_producers];
+    for (std::uint32_t p = 0; p < n_producers; ++p) {
+        children[p] = fork_child([&] {
+            auto producer = shm_any_queue::open(name);
+            for (std::uint32_t i = 0; i < n; ++i) {
+                // Mix record sizes so that producers commit out of order and records wrap around.
+                if (i % 7 == 0) {
+                    while (!producer.try_push(std::uint64_t{p})) {
+                        std::this_thread::yield();
+                    }
+                }
+                while (!producer.try_push(message{p, i})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        REQUIRE(children[p] > 0);
+    }
+
+    std::uint32_t next[n_producers] = {};
+    std::uint32_t received = 0;
+    bool in_order = true;
+    while (received < n_producers * n) {
+        if (auto any = queue.try_pop()) {
+            if (auto *m = any_cast<message>(&*any)) {
+                in_order = in_order && m->producer < n_producers && m->sequence == next[m->producer];
+                next[m->producer] += 1;
+                ++received;
+            }
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    CHECK(in_order);
+    for (auto child : children) {
+        CHECK(wait_child(child));
+    }
+    shm_any_queue::remove(name);
+}
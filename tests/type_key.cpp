@@ -0,0 +1,86 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/type_key.hpp"
+#include "doctest/doctest.h"
+#include "mcpp/any_ref.hpp"
+#include "type_key_plugin.hpp"
+#include <dlfcn.h>
+#include <utility>
+
+using namespace mcpp;
+
+namespace {
+
+struct internal {};
+
+} // namespace
+
+static_assert(type_key_v<int> != type_key_v<long>);
+static_assert(type_key_v<int> != type_key_v<void>);
+static_assert(type_key_v<plugin::small_message> != type_key_v<plugin::large_message>);
+
+static_assert(has_unique_type_key_v<int>);
+static_assert(has_unique_type_key_v<std::pair<plugin::small_message, void (*)(int)>>);
+static_assert(!has_unique_type_key_v<internal>);
+static_assert(!has_unique_type_key_v<std::pair<int, internal>>);
+
+TEST_CASE("keys") {
+    auto any = unique_any(plugin::small_message{1});
+    CHECK(any.type_key() == type_key_v<plugin::small_message>);
+    CHECK(unique_any().type_key() == type_key_v<void>);
+    CHECK(any_cast<const plugin::small_message>(&any) != nullptr);
+}
+
+TEST_CASE("key_is_the_identity") {
+    // Payloads of types with a unique key are cast by key alone, whichever type_info object they carry.
+    auto value = 42;
+    auto ref = any_ref(typeid(long), type_key_v<int>, &value);
+    CHECK(any_cast<int>(ref) == 42);
+    CHECK(any_cast<long>(&ref) == nullptr);
+}
+
+TEST_CASE("same_key_different_types") {
+    // Both lambdas have the same pretty-printed name with some compilers, and so the same key.
+    auto a = [] { return 1; };
+    auto b = [] { return 2; };
+    struct local {};
+    static_assert(!has_unique_type_key_v<decltype(a)>);
+    static_assert(!has_unique_type_key_v<local>);
+    auto any = unique_any(a);
+    CHECK(any_cast<decltype(a)>(&any) != nullptr);
+    CHECK(any_cast<decltype(b)>(&any) == nullptr);
+    CHECK(any_cast<decltype(b)>(&std::as_const(any)) == nullptr);
+    CHECK(!(any == unique_any(b)));
+    CHECK(three_way_compare(any, unique_any(b)) == -three_way_compare(unique_any(b), any));
+    CHECK(three_way_compare(any, unique_any(b)) != 0);
+
+    auto ref = any_ref(a);
+    CHECK(any_cast<decltype(a)>(&ref) != nullptr);
+    CHECK(any_cast<decltype(b)>(&ref) == nullptr);
+}
+
+TEST_CASE("across_shared_libraries") {
+    // RTLD_LOCAL and hidden visibility give each plugin its own copy of the vtables and type_info objects.
+    auto *producer = dlopen(MCPP_TEST_PRODUCER_PLUGIN, RTLD_NOW | RTLD_LOCAL);
+    auto *consumer = dlopen(MCPP_TEST_CONSUMER_PLUGIN, RTLD_NOW | RTLD_LOCAL);
+    REQUIRE(producer != nullptr);
+    REQUIRE(consumer != nullptr);
+    auto make_messages = reinterpret_cast<plugin::make_messages_fn>(dlsym(producer, "make_messages"));
+    auto read_messages = reinterpret_cast<plugin::read_messages_fn>(dlsym(consumer, "read_messages"));
+    REQUIRE(make_messages != nullptr);
+    REQUIRE(read_messages != nullptr);
+
+    auto small = unique_any();
+    auto large = unique_any();
+    make_messages(&small, &large, 21);
+    CHECK(read_messages(&small, &large) == 42);
+    CHECK(any_cast<plugin::large_message &>(large).text == "from producer");
+
+    // The payloads' destructors live in the producer, so destroy them before unloading it.
+    small.reset();
+    large.reset();
+    dlclose(consumer);
+    dlclose(producer);
+}
@@ -0,0 +1,32 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "mcpp/unique_any.hpp"
+#include <string>
+
+#if defined(_WIN32)
+#define MCPP_TEST_PLUGIN_EXPORT extern "C" __declspec(dllexport)
+#else
+#define MCPP_TEST_PLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace plugin {
+
+struct small_message {
+    int value;
+};
+
+struct large_message {
+    int value;
+    std::string text;
+};
+
+// Exported by the producer plugin.
+using make_messages_fn = void (*)(mcpp::unique_any *small, mcpp::unique_any *large, int value);
+// Exported by the consumer plugin. Returns the sum of the values of both messages, or -1 if a cast fails.
+using read_messages_fn = int (*)(const mcpp::unique_any *small, const mcpp::unique_any *large);
+
+} // namespace plugin
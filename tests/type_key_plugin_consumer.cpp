@@ -0,0 +1,14 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "type_key_plugin.hpp"
+
+MCPP_TEST_PLUGIN_EXPORT int read_messages(const mcpp::unique_any *small, const mcpp::unique_any *large) {
+    const auto *s = mcpp::any_cast<plugin::small_message>(small);
+    const auto *l = mcpp::any_cast<plugin::large_message>(large);
+    if (s == nullptr || l == nullptr || l->text != "from producer") {
+        return -1;
+    }
+    return s->value + l->value;
+}
@@ -0,0 +1,10 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "type_key_plugin.hpp"
+
+MCPP_TEST_PLUGIN_EXPORT void make_messages(mcpp::unique_any *small, mcpp::unique_any *large, int value) {
+    *small = plugin::small_message{value};
+    *large = plugin::large_message{value, "from producer"};
+}
@@ -4,14 +4,94 @@
 
 #include "mcpp/unique_any.hpp"
 #include "doctest/doctest.h"
+#include "allocation_counter.hpp"
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 using namespace mcpp;
 
 namespace {
 
+struct relocatable_handle {
+    explicit relocatable_handle(int id, int &n_moves, int &n_destroyed)
+        : id(id), n_moves(&n_moves), n_destroyed(&n_destroyed) {}
+    relocatable_handle(const relocatable_handle &other) = delete;
+    relocatable_handle(relocatable_handle &&other) noexcept
+        : id(other.id), n_moves(other.n_moves), n_destroyed(other.n_destroyed) {
+        ++*n_moves;
+    }
+    auto operator=(const relocatable_handle &rhs) -> relocatable_handle & = delete;
+    auto operator=(relocatable_handle &&rhs) -> relocatable_handle & = delete;
+    ~relocatable_handle() { ++*n_destroyed; }
+    int id;
+    int *n_moves;
+    int *n_destroyed;
+};
+
+// std::is_copy_constructible is true for this aggregate, but its copy constructor does not compile.
+struct move_only_holder {
+    std::vector<std::unique_ptr<int>> items;
+};
+
+struct replay_message {
+    std::string topic;
+    std::vector<int> values;
+};
+
+} // namespace
+
+template <>
+struct mcpp::is_trivially_relocatable<relocatable_handle> : std::true_type {};
+template <>
+struct mcpp::is_cloneable<move_only_holder> : std::false_type {};
+
+namespace {
+
+struct parse_tree {
+    parse_tree() { n_constructed += 1; }
+    std::vector<int> nodes;
+    std::string source;
+    static inline int n_constructed = 0;
+};
+
+} // namespace
+
+namespace {
+
+struct huge {
+    std::array<char, huge_payload_threshold> data;
+};
+
+struct mapped {
+    int value;
+    char padding[64];
+};
+
+} // namespace
+
+template <>
+struct mcpp::is_huge_payload<mapped> : std::true_type {};
+
+template <>
+struct mcpp::pool_traits<parse_tree> {
+    static constexpr std::size_t capacity = 2;
+    static void reset(parse_tree &tree) noexcept {
+        tree.nodes.clear();
+        tree.source.clear();
+    }
+};
+
+namespace {
+
 struct small {
     void *a[3];
 };
@@ -24,19 +104,19 @@ static_assert(sizeof(unique_any) == 4 * sizeof(void *));
 static_assert(sizeof(small) + sizeof(void *) <= sizeof(unique_any));
 static_assert(sizeof(large) + sizeof(void *) > sizeof(unique_any));
 
-int n_allocs = 0;
+struct compact_small {
+    char a[4 * sizeof(void *) - sizeof(std::uint16_t)];
+};
 
-} // namespace
+static_assert(sizeof(compact_unique_any) == sizeof(unique_any));
+static_assert(sizeof(compact_small) > unique_any::buffer_size);
+static_assert(sizeof(compact_small) <= compact_unique_any::buffer_size);
 
-auto operator new(std::size_t size) -> void * {
-    n_allocs += 1;
-    return std::malloc(size == 0 ? 1 : size);
-}
+static_assert(sizeof(slim_unique_any) == 2 * sizeof(void *));
+static_assert(sizeof(cacheline_unique_any) == 64);
+static_assert(alignof(cacheline_unique_any) == 64);
 
-void operator delete(void *mem) noexcept {
-    n_allocs -= 1;
-    std::free(mem);
-}
+} // namespace
 
 TEST_CASE("basic") {
     auto any = unique_any();
@@ -63,19 +143,19 @@ TEST_CASE("basic") {
 }
 
 TEST_CASE("small_buffer") {
-    auto pre = n_allocs;
+    auto pre = allocations::live();
     auto any = unique_any(small{});
-    CHECK(n_allocs - pre == 0);
+    CHECK(allocations::live() - pre == 0);
 }
 
 TEST_CASE("allocating") {
-    auto pre = n_allocs;
+    auto pre = allocations::live();
     auto any = unique_any(large{});
-    CHECK(n_allocs - pre == 1);
+    CHECK(allocations::live() - pre == 1);
 
-    pre = n_allocs;
+    pre = allocations::live();
     any = {};
-    CHECK(n_allocs - pre == -1);
+    CHECK(allocations::live() - pre == -1);
 }
 
 TEST_CASE("immovable") {
@@ -87,3 +167,267 @@ TEST_CASE("immovable") {
     CHECK(any2.has_value());
     CHECK(any_cast<std::atomic<int> &>(any2) == 42);
 }
+
+TEST_CASE("prefetch") {
+    unique_any().prefetch();
+    unique_any(small{}).prefetch();
+    unique_any(large{}).prefetch();
+}
+
+TEST_CASE("from_factory") {
+    struct immovable {
+        explicit immovable(int value) : value(value) {}
+        immovable(const immovable &other) = delete;
+        immovable(immovable &&other) = delete;
+        auto operator=(const immovable &rhs) -> immovable & = delete;
+        auto operator=(immovable &&rhs) -> immovable & = delete;
+        ~immovable() = default;
+        int value;
+    };
+    auto any = unique_any(from_factory, [] { return immovable(42); });
+    CHECK(any.type() == typeid(immovable));
+    CHECK(any_cast<immovable &>(any).value == 42);
+
+    auto &ref = any.emplace_from([] { return immovable(43); });
+    CHECK(ref.value == 43);
+    CHECK(&ref == any_cast<immovable>(&any));
+
+    struct counting {
+        explicit counting(int &n_moves) : n_moves(&n_moves) {}
+        counting(const counting &other) = delete;
+        counting(counting &&other) noexcept : n_moves(other.n_moves) { ++*n_moves; }
+        auto operator=(const counting &rhs) -> counting & = delete;
+        auto operator=(counting &&rhs) -> counting & = delete;
+        ~counting() = default;
+        int *n_moves;
+    };
+    auto n_moves = 0;
+    auto pre = allocations::live();
+    any.emplace_from([&] { return counting(n_moves); });
+    CHECK(allocations::live() - pre == -1);
+    CHECK(n_moves == 0);
+}
+
+TEST_CASE("compact") {
+    auto pre = allocations::live();
+    auto any = compact_unique_any(compact_small{{'x'}});
+    CHECK(allocations::live() - pre == 0);
+    CHECK(any.type() == typeid(compact_small));
+
+    auto any2 = std::move(any);
+    CHECK(!any.has_value());
+    CHECK(any_cast<compact_small &>(any2).a[0] == 'x');
+
+    pre = allocations::live();
+    any = large{};
+    CHECK(allocations::live() - pre == 1);
+    swap(any, any2);
+    CHECK(any.type() == typeid(compact_small));
+    CHECK(any2.type() == typeid(large));
+    any2.reset();
+    CHECK(allocations::live() - pre == 0);
+
+    pre = allocations::live();
+    auto regular = unique_any(compact_small{});
+    CHECK(allocations::live() - pre == 1);
+}
+
+namespace {
+
+template <class Any>
+void check_dispatch() {
+    auto pre = allocations::live();
+    {
+        auto any = Any(small{});
+        CHECK(allocations::live() - pre == 0);
+        CHECK(any.type() == typeid(small));
+        auto any2 = Any(std::make_unique<std::string>("Foo"));
+        any2.swap(any);
+        CHECK(*any_cast<std::unique_ptr<std::string> &>(any) == "Foo");
+        CHECK(any_cast<small>(&any2) != nullptr);
+        any2 = large{};
+        CHECK(any2.type() == typeid(large));
+        auto any3 = std::move(any2);
+        CHECK(!any2.has_value());
+        CHECK(any_cast<large>(&any3) != nullptr);
+        CHECK(Any(1) == Any(1));
+        CHECK(Any(1).hash() == std::hash<int>{}(1));
+        CHECK(three_way_compare(Any(1), Any(2)) < 0);
+        CHECK(Any(2).try_clone() == Any(2));
+    }
+    CHECK(allocations::live() - pre == 0);
+}
+
+} // namespace
+
+TEST_CASE("cacheline") {
+    struct alignas(32) counter {
+        std::uint64_t value;
+    };
+    struct state {
+        void *a[cacheline_unique_any::buffer_size / sizeof(void *)];
+    };
+    // Payloads aligned to a whole cache line are at least as large as the line, so they never fit.
+    struct alignas(64) line {
+        std::uint64_t value;
+    };
+    constexpr auto size = cacheline_unique_any::buffer_size;
+    constexpr auto align = cacheline_unique_any::buffer_alignment;
+    static_assert(detail::is_small_object_v<counter, size, align>);
+    static_assert(detail::is_small_object_v<state, size, align>);
+    static_assert(!detail::is_small_object_v<line, size, align>);
+
+    auto pre = allocations::live();
+    auto slots = std::array<cacheline_unique_any, 2>{counter{1}, state{}};
+    CHECK(allocations::live() - pre == 0);
+    CHECK(any_cast<counter &>(slots[0]).value == 1);
+    CHECK(reinterpret_cast<std::uintptr_t>(any_cast<counter>(&slots[0])) % alignof(counter) == 0);
+    CHECK(reinterpret_cast<std::uintptr_t>(&slots[1]) - reinterpret_cast<std::uintptr_t>(&slots[0]) == 64);
+
+    slots[1] = line{2};
+    CHECK(allocations::live() - pre == 1);
+    CHECK(any_cast<line &>(slots[1]).value == 2);
+}
+
+TEST_CASE("dispatch_policies") {
+    check_dispatch<basic_unique_any<unique_any::buffer_size, alignof(void *), vtable_dispatch>>();
+    check_dispatch<basic_unique_any<unique_any::buffer_size, alignof(void *), index_dispatch>>();
+    check_dispatch<basic_unique_any<unique_any::buffer_size, alignof(void *), manager_dispatch>>();
+    check_dispatch<basic_unique_any<unique_any::buffer_size, alignof(void *), inline_dispatch>>();
+    static_assert(sizeof(basic_unique_any<unique_any::buffer_size, alignof(void *), manager_dispatch>) ==
+                  sizeof(unique_any));
+}
+
+TEST_CASE("trivially_relocatable") {
+    auto n_moves = 0;
+    auto n_destroyed = 0;
+    {
+        auto any = unique_any(std::in_place_type<relocatable_handle>, 1, n_moves, n_destroyed);
+        auto any2 = std::move(any);
+        auto any3 = unique_any(std::in_place_type<relocatable_handle>, 3, n_moves, n_destroyed);
+        swap(any2, any3);
+        CHECK(any_cast<relocatable_handle &>(any2).id == 3);
+        CHECK(any_cast<relocatable_handle &>(any3).id == 1);
+        CHECK(n_moves == 0);
+        CHECK(n_destroyed == 0);
+    }
+    CHECK(n_destroyed == 2);
+}
+
+TEST_CASE("slim") {
+    auto pre = allocations::live();
+    auto any = slim_unique_any(std::make_unique<int>(42));
+    CHECK(allocations::live() - pre == 1);
+    auto any2 = slim_unique_any(small{});
+    CHECK(allocations::live() - pre == 2);
+    swap(any, any2);
+    CHECK(**any_cast<std::unique_ptr<int>>(&any2) == 42);
+    CHECK(any_cast<small>(&any) != nullptr);
+    any.reset();
+    any2.reset();
+    CHECK(allocations::live() - pre == 0);
+}
+
+TEST_CASE("pooled") {
+    static_assert(sizeof(parse_tree) > unique_any::buffer_size);
+    auto pre = parse_tree::n_constructed;
+    auto any = unique_any(std::in_place_type<parse_tree>);
+    auto *tree = any_cast<parse_tree>(&any);
+    tree->nodes.resize(100);
+    any.reset();
+
+    // Reused, already constructed, reset but still with its capacity
+    auto &reused = any.emplace<parse_tree>();
+    CHECK(&reused == tree);
+    CHECK(reused.nodes.empty());
+    CHECK(reused.nodes.capacity() >= 100);
+    CHECK(parse_tree::n_constructed - pre == 1);
+
+    // The pool is empty now, and never holds more than its capacity
+    {
+        auto anys = std::vector<unique_any>(4);
+        for (auto &a : anys) {
+            a.emplace<parse_tree>();
+        }
+        CHECK(parse_tree::n_constructed - pre == 5);
+    }
+    auto allocs = allocations::live();
+    auto any2 = unique_any(std::in_place_type<parse_tree>);
+    auto any3 = unique_any(std::in_place_type<parse_tree>);
+    CHECK(allocations::live() == allocs);
+    CHECK(parse_tree::n_constructed - pre == 5);
+    auto any4 = unique_any(std::in_place_type<parse_tree>);
+    CHECK(parse_tree::n_constructed - pre == 6);
+}
+
+TEST_CASE("huge") {
+    auto pre = allocations::live();
+    {
+        auto any = unique_any(std::in_place_type<huge>);
+        auto &data = any_cast<huge &>(any).data;
+        data.fill('x');
+        auto any2 = std::move(any);
+        CHECK(any_cast<huge &>(any2).data.back() == 'x');
+        auto any3 = unique_any(std::in_place_type<mapped>, mapped{42, {}});
+        CHECK(any_cast<mapped &>(any3).value == 42);
+#if defined(__linux__)
+        CHECK(allocations::live() == pre);
+        CHECK(reinterpret_cast<std::uintptr_t>(&data) % 4096 == 0);
+        CHECK(reinterpret_cast<std::uintptr_t>(any_cast<mapped>(&any3)) % 4096 == 0);
+#endif
+    }
+    CHECK(allocations::live() == pre);
+}
+
+TEST_CASE("try_clone") {
+    static_assert(is_cloneable_v<small>);
+    static_assert(is_cloneable_v<std::string>);
+    static_assert(is_cloneable_v<std::vector<std::string>>);
+    static_assert(is_cloneable_v<std::vector<int>>);
+    static_assert(is_cloneable_v<std::map<std::string, std::vector<int>>>);
+    static_assert(is_cloneable_v<std::pair<const int, std::string>>);
+    static_assert(is_cloneable_v<std::tuple<int, std::string>>);
+    static_assert(is_cloneable_v<std::optional<std::string>>);
+    static_assert(is_cloneable_v<replay_message>);
+    static_assert(!is_cloneable_v<std::unique_ptr<int>>);
+    static_assert(!is_cloneable_v<std::vector<std::unique_ptr<int>>>);
+    static_assert(!is_cloneable_v<std::map<int, std::unique_ptr<int>>>);
+    static_assert(!is_cloneable_v<std::pair<int, std::vector<std::unique_ptr<int>>>>);
+    static_assert(!is_cloneable_v<std::tuple<int, std::unique_ptr<int>>>);
+    static_assert(!is_cloneable_v<std::optional<std::vector<std::unique_ptr<int>>>>);
+    static_assert(!is_cloneable_v<std::array<std::vector<std::unique_ptr<int>>, 2>>);
+    static_assert(std::is_copy_constructible_v<move_only_holder> && !is_cloneable_v<move_only_holder>);
+
+    CHECK(!unique_any().try_clone().has_value());
+    CHECK(!unique_any(std::make_unique<int>(1)).try_clone().has_value());
+    CHECK(!unique_any(std::vector<std::unique_ptr<int>>(2)).try_clone().has_value());
+    CHECK(!unique_any(move_only_holder{}).try_clone().has_value());
+
+    auto ints = unique_any(std::vector<int>{1, 2, 3});
+    auto ints_copy = ints.try_clone();
+    CHECK(any_cast<std::vector<int> &>(ints_copy) == std::vector<int>{1, 2, 3});
+    auto message = unique_any(replay_message{"orders", {4, 5}});
+    auto message_copy = message.try_clone();
+    CHECK(any_cast<replay_message &>(message_copy).topic == "orders");
+    CHECK(any_cast<replay_message &>(message_copy).values == std::vector<int>{4, 5});
+
+    auto pre = allocations::live();
+    auto any = unique_any(small{});
+    auto copy = any.try_clone();
+    CHECK(copy.type() == typeid(small));
+    CHECK(allocations::live() == pre);
+
+    auto strings = unique_any(std::vector<std::string>{"foo", "bar"});
+    auto strings_copy = strings.try_clone();
+    CHECK(any_cast<std::vector<std::string> &>(strings_copy) == std::vector<std::string>{"foo", "bar"});
+    CHECK(any_cast<std::vector<std::string> &>(strings).size() == 2);
+    CHECK(any_cast<std::vector<std::string>>(&strings) != any_cast<std::vector<std::string>>(&strings_copy));
+
+    auto big = unique_any(large{});
+    auto big_copy = big.try_clone();
+    CHECK(big_copy.type() == typeid(large));
+    CHECK(any_cast<large>(&big) != any_cast<large>(&big_copy));
+
+    auto compact = compact_unique_any(std::string(100, 'x')).try_clone();
+    CHECK(any_cast<std::string &>(compact) == std::string(100, 'x'));
+}
@@ -0,0 +1,82 @@
+// Copyright Mika Fischer 2022.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include "mcpp/unique_array.hpp"
+#include "mcpp/unique_any.hpp"
+#include "doctest/doctest.h"
+#include "allocation_counter.hpp"
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace mcpp;
+
+namespace {
+
+struct alignas(64) over_aligned {
+    int value = 7;
+};
+
+struct throws_at {
+    explicit throws_at(int *n_constructed, int *n_destroyed, int limit) : n_destroyed(n_destroyed) {
+        if (*n_constructed == limit) {
+            throw std::runtime_error("limit");
+        }
+        *n_constructed += 1;
+    }
+    throws_at(const throws_at &other) = delete;
+    auto operator=(const throws_at &rhs) -> throws_at & = delete;
+    ~throws_at() { *n_destroyed += 1; }
+    int *n_destroyed;
+};
+
+} // namespace
+
+static_assert(sizeof(unique_array<int>) == sizeof(void *));
+static_assert(is_trivially_relocatable_v<unique_array<std::string>>);
+
+TEST_CASE("single_allocation") {
+    auto pre = allocations::live();
+    {
+        auto any = make_unique_any_array<std::uint64_t>(1000, std::uint64_t{3});
+        CHECK(allocations::live() - pre == 1);
+        auto &array = any_cast<unique_array<std::uint64_t> &>(any);
+        CHECK(array.size() == 1000);
+        CHECK(std::accumulate(array.begin(), array.end(), std::uint64_t{0}) == 3000);
+        array[999] = 4;
+
+        auto moved = std::move(any);
+        CHECK(allocations::live() - pre == 1);
+        CHECK(any_cast<unique_array<std::uint64_t> &>(moved)[999] == 4);
+    }
+    CHECK(allocations::live() == pre);
+}
+
+TEST_CASE("elements") {
+    auto any = make_unique_any_array<std::string>(3, "abc");
+    const auto &array = any_cast<const unique_array<std::string> &>(any);
+    for (const auto &value : array) {
+        CHECK(value == "abc");
+    }
+
+    auto empty = make_unique_any_array<std::string>(0);
+    CHECK(any_cast<unique_array<std::string> &>(empty).empty());
+    CHECK(any_cast<unique_array<std::string> &>(empty).size() == 0);
+
+    auto aligned = unique_array<over_aligned>(5);
+    CHECK(reinterpret_cast<std::uintptr_t>(aligned.data()) % 64 == 0);
+    CHECK(aligned[4].value == 7);
+}
+
+TEST_CASE("constructor_throws") {
+    auto pre = allocations::live();
+    auto n_constructed = 0;
+    auto n_destroyed = 0;
+    CHECK_THROWS_AS(unique_array<throws_at>(5, &n_constructed, &n_destroyed, 3), std::runtime_error);
+    CHECK(n_constructed == 3);
+    CHECK(n_destroyed == 3);
+    CHECK(allocations::live() == pre);
+}